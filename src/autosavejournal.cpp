@@ -0,0 +1,505 @@
+#include "autosavejournal.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QtConcurrent>
+#include <algorithm>
+
+// entries appended before the journal is compacted into a checkpoint
+static const int compactEvery=200;
+
+static QByteArray compactItem(const QJsonValue &item)
+{
+    return QJsonDocument(item.toObject()).toJson(QJsonDocument::Compact);
+}
+/*!
+ * \brief split document into items and its other members
+ * \param doc
+ * \param items
+ * \param rest
+ */
+static void splitDocument(const QJsonDocument &doc, QJsonArray &items, QJsonObject &rest)
+{
+    if(doc.isArray()){
+        items=doc.array();
+        rest=QJsonObject();
+        return;
+    }
+    rest=doc.object();
+    items=rest.take("items").toArray();
+    rest.remove("header");
+}
+/*!
+ * \brief first line of journal, identifies the saved document it applies to
+ * \param state
+ * \return
+ */
+static QByteArray headerLine(const AutosaveJournal::State &state)
+{
+    QJsonObject header;
+    header["journal"]=1;
+    header["document"]=state.documentFile;
+    if(!state.documentFile.isEmpty()){
+        const QFileInfo fi(state.documentFile);
+        header["size"]=double(fi.size());
+        header["modified"]=double(fi.lastModified().toMSecsSinceEpoch());
+    }
+    return QJsonDocument(header).toJson(QJsonDocument::Compact)+'\n';
+}
+/*!
+ * \brief take document as the state the journal starts from
+ * \param state
+ * \param doc
+ */
+static void readDocument(AutosaveJournal::State &state, const QJsonDocument &doc)
+{
+    QJsonArray items;
+    splitDocument(doc,items,state.rest);
+    for(const QJsonValue &item:items){
+        state.items<<compactItem(item);
+    }
+    state.valid=true;
+}
+/*!
+ * \brief read saved document as base of the journal
+ * Runs on a worker thread. The journal file itself is only written once
+ * there are changes.
+ * \param state
+ * \return
+ */
+static AutosaveJournal::State startJournal(AutosaveJournal::State state)
+{
+    QJsonDocument doc;
+    if(!state.documentFile.isEmpty()){
+        QFile file(state.documentFile);
+        if(!file.open(QIODevice::ReadOnly)){
+            return state;
+        }
+        doc=QJsonDocument::fromJson(file.readAll());
+    }
+    readDocument(state,doc);
+    return state;
+}
+/*!
+ * \brief replace journal by header and one checkpoint of the current state
+ * \param state
+ * \return true if written
+ */
+static bool compactJournal(AutosaveJournal::State &state)
+{
+    QSaveFile file(state.journalFile);
+    if(!file.open(QIODevice::WriteOnly)){
+        return false;
+    }
+    file.write(headerLine(state));
+    // items are kept as compact JSON already, no need to parse them again
+    QByteArray line="{\"checkpoint\":true,\"items\":["+state.items.join(',')+"]";
+    const QByteArray rest=QJsonDocument(state.rest).toJson(QJsonDocument::Compact);
+    if(rest.size()>2){
+        line+=','+rest.mid(1,rest.size()-2);
+    }
+    line+="}\n";
+    file.write(line);
+    if(!file.commit()){
+        return false;
+    }
+    state.entries=0;
+    return true;
+}
+/*!
+ * \brief append the difference to the last recorded state
+ * Runs on a worker thread. Items are matched by content, so unchanged
+ * items cost nothing regardless of their order.
+ * \param state
+ * \param doc
+ * \return
+ */
+static AutosaveJournal::State recordJournal(AutosaveJournal::State state, const QJsonDocument &doc)
+{
+    QJsonArray items;
+    QJsonObject rest;
+    splitDocument(doc,items,rest);
+
+    QHash<QByteArray,QList<int>> positions;
+    for(int i=0;i<state.items.size();++i){
+        positions[state.items.at(i)]<<i;
+    }
+    QJsonArray added;
+    QList<QByteArray> addedItems;
+    for(const QJsonValue &item:items){
+        const QByteArray data=compactItem(item);
+        auto it=positions.find(data);
+        if(it!=positions.end() && !it->isEmpty()){
+            it->removeLast();
+        }else{
+            added<<item;
+            addedItems<<data;
+        }
+    }
+    QList<int> removed;
+    for(auto it=positions.cbegin();it!=positions.cend();++it){
+        removed<<it.value();
+    }
+    std::sort(removed.begin(),removed.end());
+
+    QJsonObject entry;
+    const QJsonObject symbols=rest["symbols"].toObject();
+    if(symbols!=state.rest["symbols"].toObject()){
+        entry["symbols"]=symbols;
+        if(symbols.isEmpty()){
+            state.rest.remove("symbols");
+        }else{
+            state.rest["symbols"]=symbols;
+        }
+    }
+    if(removed.isEmpty() && added.isEmpty() && entry.isEmpty()){
+        return state;
+    }
+    if(!removed.isEmpty()){
+        QJsonArray indexes;
+        for(int i:removed){
+            indexes<<i;
+        }
+        entry["remove"]=indexes;
+    }
+    if(!added.isEmpty()){
+        entry["add"]=added;
+    }
+    for(int i=removed.size()-1;i>=0;--i){
+        state.items.removeAt(removed.at(i));
+    }
+    state.items<<addedItems;
+
+    QFile file(state.journalFile);
+    const QIODevice::OpenMode mode=state.modified ? QIODevice::OpenMode(QIODevice::Append)
+                                                  : QIODevice::WriteOnly|QIODevice::Truncate;
+    if(!file.open(mode)){
+        return state;
+    }
+    if(!state.modified){
+        file.write(headerLine(state));
+    }
+    file.write(QJsonDocument(entry).toJson(QJsonDocument::Compact)+'\n');
+    file.close();
+    state.modified=true;
+    if(++state.entries>=compactEvery){
+        compactJournal(state);
+    }
+    return state;
+}
+
+AutosaveJournal::AutosaveJournal(QObject *parent)
+    : QObject(parent), m_lock(nullptr), m_running(false), m_startPending(false), m_recordPending(false)
+{
+    connect(&m_job,&QFutureWatcher<State>::finished,this,&AutosaveJournal::jobFinished);
+}
+
+AutosaveJournal::~AutosaveJournal()
+{
+    m_job.waitForFinished();
+    delete m_lock;
+}
+/*!
+ * \brief journal changes of document
+ * The document must be saved, it is the base the journal applies to. A
+ * recovered state is written as first checkpoint before returning, so the
+ * journal it came from can be removed afterwards.
+ * \param documentFile empty for a new document
+ * \param recovered unsaved state of the document, see recover()
+ * \return false if the journal is in use by another instance or the
+ * recovered state could not be written
+ */
+bool AutosaveJournal::start(const QString &documentFile, const QJsonDocument &recovered)
+{
+    if(documentFile.isEmpty()){
+        QDir().mkpath(QFileInfo(journalFile(documentFile)).absolutePath());
+    }
+    // states recorded before belong to the previous document
+    m_recordPending=false;
+    m_pendingDoc=QJsonDocument();
+    if(!lock(journalFile(documentFile))){
+        m_startPending=false;
+        m_job.waitForFinished();
+        m_running=false;
+        m_state=State();
+        return false;
+    }
+    if(recovered.isNull()){
+        m_startPending=true;
+        m_pendingDocumentFile=documentFile;
+        schedule();
+        return true;
+    }
+    m_startPending=false;
+    m_job.waitForFinished();
+    m_running=false;
+    State state;
+    state.documentFile=documentFile;
+    state.journalFile=journalFile(documentFile);
+    readDocument(state,recovered);
+    if(!compactJournal(state)){
+        m_state=State();
+        unlock();
+        return false;
+    }
+    state.modified=true;
+    m_state=state;
+    return true;
+}
+/*!
+ * \brief journal state of the document
+ * Returns immediately, states recorded while the worker is busy are
+ * merged into one entry.
+ * \param doc
+ */
+void AutosaveJournal::record(const QJsonDocument &doc)
+{
+    m_recordPending=true;
+    m_pendingDoc=doc;
+    schedule();
+}
+/*!
+ * \brief write outstanding changes and stop
+ * The journal is kept if it holds changes, so they can be recovered.
+ */
+void AutosaveJournal::stop()
+{
+    m_job.waitForFinished();
+    if(m_running){
+        m_state=m_job.result();
+        m_running=false;
+    }
+    if(m_recordPending && m_state.valid && !m_startPending){
+        m_state=recordJournal(m_state,m_pendingDoc);
+    }
+    m_startPending=false;
+    m_recordPending=false;
+    m_pendingDoc=QJsonDocument();
+    m_state=State();
+    unlock();
+}
+/*!
+ * \brief stop and remove journal, e.g. after the document was saved
+ */
+void AutosaveJournal::discard()
+{
+    m_job.waitForFinished();
+    if(m_running){
+        m_state=m_job.result();
+        m_running=false;
+    }
+    if(!m_state.journalFile.isEmpty()){
+        QFile::remove(m_state.journalFile);
+    }
+    m_startPending=false;
+    m_recordPending=false;
+    m_pendingDoc=QJsonDocument();
+    m_state=State();
+    unlock();
+}
+/*!
+ * \brief journal of document
+ * \param documentFile empty for a new document, its journal is named
+ * after the process
+ * \return
+ */
+QString AutosaveJournal::journalFile(const QString &documentFile)
+{
+    if(documentFile.isEmpty()){
+        return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+                +QString("/untitled-%1.journal").arg(QCoreApplication::applicationPid());
+    }
+    return documentFile+".journal";
+}
+/*!
+ * \brief journal left behind by an instance which is not running anymore
+ * Journals of running instances are locked and not offered.
+ * \param documentFile empty for a new document, the latest journal of
+ * any instance is taken then
+ * \return empty if there is none
+ */
+QString AutosaveJournal::abandonedJournal(const QString &documentFile)
+{
+    QStringList journals;
+    if(documentFile.isEmpty()){
+        const QDir dir(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation));
+        for(const QString &name:dir.entryList({"untitled-*.journal"},QDir::Files,QDir::Time)){
+            journals<<dir.filePath(name);
+        }
+    }else if(QFileInfo::exists(journalFile(documentFile))){
+        journals<<journalFile(documentFile);
+    }
+    for(const QString &journal:journals){
+        QLockFile lock(journal+".lock");
+        lock.setStaleLockTime(0);
+        if(lock.tryLock(0)){
+            return journal;
+        }
+    }
+    return QString();
+}
+/*!
+ * \brief replay journal onto saved document
+ * An incomplete last entry, e.g. from a crash while writing, is ignored.
+ * If the document was saved since the journal was started, the entries
+ * before the last checkpoint are not needed, so only the state from the
+ * checkpoint on can be recovered.
+ * \param documentFile empty for a new document
+ * \param fileName journal, see abandonedJournal()
+ * \param outdated set to true if the document was saved since
+ * \return recovered document, null if the journal does not apply
+ */
+QJsonDocument AutosaveJournal::recover(const QString &documentFile, const QString &fileName, bool *outdated)
+{
+    if(outdated){
+        *outdated=false;
+    }
+    QFile journal(fileName);
+    if(!journal.open(QIODevice::ReadOnly)){
+        return QJsonDocument();
+    }
+    const QJsonObject header=QJsonDocument::fromJson(journal.readLine()).object();
+    if(header["journal"].toInt()!=1){
+        return QJsonDocument();
+    }
+    QJsonArray items;
+    QJsonObject rest;
+    // false while the entries have nothing to apply to
+    bool based=true;
+    if(!documentFile.isEmpty()){
+        // document saved since, e.g. by another instance
+        const QFileInfo fi(documentFile);
+        if(header["size"].toDouble()!=double(fi.size())
+                || header["modified"].toDouble()!=double(fi.lastModified().toMSecsSinceEpoch())){
+            based=false;
+            if(outdated){
+                *outdated=true;
+            }
+        }else{
+            QFile file(documentFile);
+            if(!file.open(QIODevice::ReadOnly)){
+                return QJsonDocument();
+            }
+            splitDocument(QJsonDocument::fromJson(file.readAll()),items,rest);
+        }
+    }
+    while(!journal.atEnd()){
+        QJsonParseError error;
+        QJsonObject entry=QJsonDocument::fromJson(journal.readLine(),&error).object();
+        if(error.error!=QJsonParseError::NoError){
+            break;
+        }
+        if(entry["checkpoint"].toBool()){
+            items=entry.take("items").toArray();
+            entry.remove("checkpoint");
+            rest=entry;
+            based=true;
+            continue;
+        }
+        if(!based){
+            continue;
+        }
+        const QJsonArray removed=entry["remove"].toArray();
+        for(int i=removed.size()-1;i>=0;--i){
+            items.removeAt(removed.at(i).toInt());
+        }
+        for(const QJsonValue &item:entry["add"].toArray()){
+            items.append(item);
+        }
+        if(entry.contains("symbols")){
+            const QJsonObject symbols=entry["symbols"].toObject();
+            if(symbols.isEmpty()){
+                rest.remove("symbols");
+            }else{
+                rest["symbols"]=symbols;
+            }
+        }
+    }
+    if(!based){
+        qWarning("Journal does not match %s",qPrintable(documentFile));
+        return QJsonDocument();
+    }
+    rest["items"]=items;
+    return QJsonDocument(rest);
+}
+/*!
+ * \brief rename journal which cannot be recovered, so it is not lost
+ * The new name is not picked up as journal anymore.
+ * \param fileName journal
+ * \return new name, empty if renaming failed
+ */
+QString AutosaveJournal::keepAside(const QString &fileName)
+{
+    const QString kept=fileName+QDateTime::currentDateTime().toString("'.'yyyyMMdd-hhmmss'.old'");
+    if(!QFile::rename(fileName,kept)){
+        return QString();
+    }
+    return kept;
+}
+
+void AutosaveJournal::jobFinished()
+{
+    if(!m_running){
+        // result was taken by stop() or discard()
+        return;
+    }
+    m_running=false;
+    m_state=m_job.result();
+    schedule();
+}
+/*!
+ * \brief lock journal against other instances
+ * A lock is only stale if its process does not run anymore, regardless
+ * of its age.
+ * \param fileName
+ * \return false if in use
+ */
+bool AutosaveJournal::lock(const QString &fileName)
+{
+    unlock();
+    m_lock=new QLockFile(fileName+".lock");
+    m_lock->setStaleLockTime(0);
+    if(!m_lock->tryLock(0)){
+        qWarning("Journal %s is in use by another instance",qPrintable(fileName));
+        unlock();
+        return false;
+    }
+    return true;
+}
+
+void AutosaveJournal::unlock()
+{
+    delete m_lock;
+    m_lock=nullptr;
+}
+/*!
+ * \brief run next job, one at a time to keep the entries in order
+ */
+void AutosaveJournal::schedule()
+{
+    if(m_running){
+        return;
+    }
+    if(m_startPending){
+        m_startPending=false;
+        State state;
+        state.documentFile=m_pendingDocumentFile;
+        state.journalFile=journalFile(m_pendingDocumentFile);
+        m_running=true;
+        m_job.setFuture(QtConcurrent::run(startJournal,state));
+    }else if(m_recordPending && m_state.valid){
+        m_recordPending=false;
+        const QJsonDocument doc=m_pendingDoc;
+        m_pendingDoc=QJsonDocument();
+        m_running=true;
+        m_job.setFuture(QtConcurrent::run(recordJournal,m_state,doc));
+    }
+}
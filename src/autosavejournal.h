@@ -0,0 +1,72 @@
+#ifndef AUTOSAVEJOURNAL_H
+#define AUTOSAVEJOURNAL_H
+
+#include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QList>
+#include <QObject>
+
+class QLockFile;
+
+/*!
+ * \brief append-only journal of unsaved changes next to the document
+ * Each recorded state is compared with the previous one on a worker
+ * thread and only the removed and added items are appended as one JSON
+ * line, so writing costs as much as the edit, not the document. After a
+ * crash, recover() replays the journal onto the saved document. The
+ * journal is compacted into a single checkpoint now and then.
+ * A journal is locked while in use, new documents get one per instance.
+ */
+class AutosaveJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    // state of journal, owned by the worker while a job runs
+    struct State
+    {
+        QString documentFile;
+        QString journalFile;
+        // compact JSON of items in journal order
+        QList<QByteArray> items;
+        // other members of the document, e.g. symbols
+        QJsonObject rest;
+        int entries=0;
+        bool modified=false;
+        bool valid=false;
+    };
+
+    explicit AutosaveJournal(QObject *parent = nullptr);
+    ~AutosaveJournal() override;
+
+    bool start(const QString &documentFile, const QJsonDocument &recovered=QJsonDocument());
+    void record(const QJsonDocument &doc);
+    void stop();
+    void discard();
+
+    static QString journalFile(const QString &documentFile);
+    static QString abandonedJournal(const QString &documentFile);
+    static QJsonDocument recover(const QString &documentFile, const QString &fileName, bool *outdated=nullptr);
+    static QString keepAside(const QString &fileName);
+
+private slots:
+    void jobFinished();
+
+private:
+    void schedule();
+    bool lock(const QString &fileName);
+    void unlock();
+
+    QFutureWatcher<State> m_job;
+    State m_state;
+    QLockFile *m_lock;
+    bool m_running;
+    bool m_startPending;
+    QString m_pendingDocumentFile;
+    // only the latest state is of interest
+    bool m_recordPending;
+    QJsonDocument m_pendingDoc;
+};
+
+#endif // AUTOSAVEJOURNAL_H
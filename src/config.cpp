@@ -5,10 +5,18 @@ Config::Config()
 {
     QSettings settings("QDia","QDia");
     showGrid=settings.value("view/showGrid", true).toBool();
+    tiledRendering=settings.value("view/tiledRendering", false).toBool();
+    parallelRendering=settings.value("view/parallelRendering", false).toBool();
+    embedElements=settings.value("file/embedElements", false).toBool();
+    libraryPaths=settings.value("library/paths").toStringList();
 }
 
 Config::~Config()
 {
     QSettings settings("QDia","QDia");
     settings.setValue("view/showGrid", showGrid);
+    settings.setValue("view/tiledRendering", tiledRendering);
+    settings.setValue("view/parallelRendering", parallelRendering);
+    settings.setValue("file/embedElements", embedElements);
+    settings.setValue("library/paths", libraryPaths);
 }
@@ -1,6 +1,8 @@
 #ifndef CONFIG_H
 #define CONFIG_H
 
+#include <QStringList>
+
 class Config
 {
 public:
@@ -9,6 +11,10 @@ public:
 
     // global configuration settings
     bool showGrid;
+    bool tiledRendering;
+    bool parallelRendering;
+    bool embedElements;
+    QStringList libraryPaths;
 
 
 };
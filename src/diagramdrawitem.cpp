@@ -7,6 +7,7 @@
 
 #include "diagramdrawitem.h"
 #include "diagramscene.h"
+#include "paintstatistics.h"
 
 //! [0]
 DiagramDrawItem::DiagramDrawItem(DiagramType diagramType, QMenu *contextMenu,
@@ -205,7 +206,7 @@ QVariant DiagramDrawItem::itemChange(GraphicsItemChange change,
         }
     }
 
-    return value;
+    return DiagramItem::itemChange(change,value);
 }
 
 DiagramItem* DiagramDrawItem::copy()
@@ -342,6 +343,7 @@ void DiagramDrawItem::setEndPoint(const QPointF pt)
 void DiagramDrawItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *,
            QWidget *)
 {
+     PaintTimer timer(Type);
      painter->setPen(pen());
      painter->setBrush(brush());
      painter->drawPath(path());
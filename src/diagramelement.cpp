@@ -1,26 +1,194 @@
 #include "diagramelement.h"
+#include "diagramscene.h"
+#include "paintstatistics.h"
 #include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QCursor>
 #include <QPainter>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QCryptographicHash>
+#include <algorithm>
 
+QHash<QString,DiagramElement::Definition> DiagramElement::s_definitions;
+QHash<QString,QString> DiagramElement::s_files;
+QHash<QString,QString> DiagramElement::s_fileStates;
+QJsonObject DiagramElement::s_embedded;
+QHash<QString,QString> DiagramElement::s_embeddedFiles;
+QHash<QString,QList<DiagramElement::Path>> DiagramElement::s_variants;
+QCache<QString,QPainterPath> DiagramElement::s_textPaths(maxTextPathCost);
+QStringList DiagramElement::s_resolving;
+QSet<QString> DiagramElement::s_reportedCycles;
+QSet<QString> DiagramElement::s_buildingVariants;
+int DiagramElement::s_cacheHits=0;
+int DiagramElement::s_cacheMisses=0;
+
+// upper limit of repeat counts in element definitions
+static const int maxRepeat=1000;
+// upper limit of parametric elements generated inside each other
+static const int maxVariantDepth=32;
+
+/*!
+ * \brief arithmetic expression in element definitions
+ * Supports + - * /, parentheses, min() and max(), numbers and names of
+ * parameters or repeat counters, e.g. "-10*max(inputs,2)+5".
+ */
+class Expression
+{
+public:
+    Expression(const QString &text, const QHash<QString,qreal> &variables)
+        : m_text(text), m_variables(variables), m_pos(0), m_ok(true) {}
+
+    qreal evaluate(bool *ok)
+    {
+        qreal value=sum();
+        skipSpace();
+        if(m_pos<m_text.size()){
+            m_ok=false;
+        }
+        *ok=m_ok;
+        return m_ok ? value : 0.;
+    }
+
+private:
+    void skipSpace()
+    {
+        while(m_pos<m_text.size() && m_text.at(m_pos).isSpace()){
+            ++m_pos;
+        }
+    }
+    bool accept(QChar c)
+    {
+        skipSpace();
+        if(m_pos<m_text.size() && m_text.at(m_pos)==c){
+            ++m_pos;
+            return true;
+        }
+        return false;
+    }
+    qreal sum()
+    {
+        qreal value=product();
+        for(;;){
+            if(accept('+')){
+                value+=product();
+            }else if(accept('-')){
+                value-=product();
+            }else{
+                return value;
+            }
+        }
+    }
+    qreal product()
+    {
+        qreal value=factor();
+        for(;;){
+            if(accept('*')){
+                value*=factor();
+            }else if(accept('/')){
+                const qreal divisor=factor();
+                if(divisor==0.){
+                    m_ok=false;
+                    return 0.;
+                }
+                value/=divisor;
+            }else{
+                return value;
+            }
+        }
+    }
+    qreal factor()
+    {
+        if(accept('-')){
+            return -factor();
+        }
+        if(accept('(')){
+            const qreal value=sum();
+            if(!accept(')')){
+                m_ok=false;
+            }
+            return value;
+        }
+        skipSpace();
+        const int start=m_pos;
+        if(m_pos<m_text.size() && (m_text.at(m_pos).isDigit() || m_text.at(m_pos)=='.')){
+            while(m_pos<m_text.size() && (m_text.at(m_pos).isDigit() || m_text.at(m_pos)=='.')){
+                ++m_pos;
+            }
+            bool ok;
+            const qreal value=m_text.mid(start,m_pos-start).toDouble(&ok);
+            m_ok=m_ok && ok;
+            return value;
+        }
+        while(m_pos<m_text.size() && (m_text.at(m_pos).isLetterOrNumber() || m_text.at(m_pos)=='_')){
+            ++m_pos;
+        }
+        const QString name=m_text.mid(start,m_pos-start);
+        if(!name.isEmpty() && accept('(')){
+            return function(name);
+        }
+        if(name.isEmpty() || !m_variables.contains(name)){
+            m_ok=false;
+            return 0.;
+        }
+        return m_variables.value(name);
+    }
+
+    qreal function(const QString &name)
+    {
+        QList<qreal> args;
+        args<<sum();
+        while(accept(',')){
+            args<<sum();
+        }
+        if(!accept(')')){
+            m_ok=false;
+            return 0.;
+        }
+        if(name=="min"){
+            return *std::min_element(args.cbegin(),args.cend());
+        }
+        if(name=="max"){
+            return *std::max_element(args.cbegin(),args.cend());
+        }
+        m_ok=false;
+        return 0.;
+    }
+
+    const QString m_text;
+    const QHash<QString,qreal> &m_variables;
+    int m_pos;
+    bool m_ok;
+};
+/*!
+ * \brief number of element definition, either plain or an expression
+ * \param value
+ * \param variables
+ * \param defaultValue used if missing or invalid
+ * \return
+ */
+static qreal number(const QJsonValue &value, const QHash<QString,qreal> &variables, qreal defaultValue=0.)
+{
+    if(value.isString()){
+        bool ok;
+        const qreal result=Expression(value.toString(),variables).evaluate(&ok);
+        if(!ok){
+            qWarning("Invalid expression in element: %s",qPrintable(value.toString()));
+            return defaultValue;
+        }
+        return result;
+    }
+    return value.toDouble(defaultValue);
+}
 
 DiagramElement::DiagramElement(const QString fileName, QMenu *contextMenu, QGraphicsItem *parent): DiagramItem(contextMenu,parent)
 {
     mFileName=fileName;
-    lstPaths=importPathFromFile(mFileName);
-    if(!lstPaths.isEmpty()){
-        QPainterPath p;
-        for(const auto &lp:lstPaths){
-            p|=lp.path;
-        }
-        setPath(p);
-        setFlag(QGraphicsItem::ItemIsMovable, true);
-        setFlag(QGraphicsItem::ItemIsSelectable, true);
-        setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
-        setAcceptHoverEvents(true);
+    mHash=resolveDefinition(mFileName);
+    if(!mHash.isEmpty()){
+        applyDefinition();
     }
 }
 
@@ -29,18 +197,9 @@ DiagramElement::DiagramElement(const DiagramElement& diagram)
 {
     mFileName=diagram.mFileName;
     mName=diagram.mName;
-    lstPaths=importPathFromFile(mFileName);
-    if(!lstPaths.isEmpty()){
-        QPainterPath p;
-        for(const auto &lp:lstPaths){
-            p|=lp.path;
-        }
-        setPath(p);
-        setFlag(QGraphicsItem::ItemIsMovable, true);
-        setFlag(QGraphicsItem::ItemIsSelectable, true);
-        setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
-        setAcceptHoverEvents(true);
-    }
+    mHash=diagram.mHash;
+    mParameters=diagram.mParameters;
+    setPaths(diagram.lstPaths);
     setTransform(diagram.transform());
     setPen(diagram.pen());
     setBrush(diagram.brush());
@@ -58,12 +217,46 @@ void DiagramElement::write(QJsonObject &obj)
     DiagramItem::write(obj);
     obj["filename"]=mFileName;
     obj["name"]=mName;
+    if(!mHash.isEmpty()){
+        obj["element"]=mHash;
+    }
+    if(!mParameters.isEmpty()){
+        obj["parameters"]=mParameters;
+    }
+}
+/*!
+ * \brief use definition for this element
+ * \param paths
+ */
+void DiagramElement::setPaths(const QList<Path> &paths)
+{
+    lstPaths=paths;
+    if(!lstPaths.isEmpty()){
+        QPainterPath p;
+        for(const auto &lp:lstPaths){
+            p|=lp.path;
+        }
+        setPath(p);
+        setFlag(QGraphicsItem::ItemIsMovable, true);
+        setFlag(QGraphicsItem::ItemIsSelectable, true);
+        setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+        setAcceptHoverEvents(true);
+    }
 }
 QPixmap DiagramElement::image() const
 {
     QPixmap pixmap(250, 250);
     pixmap.fill(Qt::transparent);
-
+    QPainter painter(&pixmap);
+    paintIcon(&painter);
+    return pixmap;
+}
+/*!
+ * \brief paint element centered into 250x250 icon area
+ * \param painter
+ */
+void DiagramElement::paintIcon(QPainter *painter) const
+{
     QRectF rect=boundingRect();
     qreal w=rect.width();
     if(w<rect.height()){
@@ -72,25 +265,23 @@ QPixmap DiagramElement::image() const
     qreal scale=qMin(4.,240/w);
     QPointF center=-rect.center()*scale+QPointF(125,125);
 
-    QPainter painter(&pixmap);
-    painter.setPen(QPen(Qt::black, 1));
-    painter.translate(center);
-    painter.scale(scale,scale);
+    painter->setPen(QPen(Qt::black, 1));
+    painter->translate(center);
+    painter->scale(scale,scale);
     foreach(Path lPath,lstPaths){
-        painter.save();
+        painter->save();
         if(lPath.filled){
-            painter.setBrush(pen().color());
+            painter->setBrush(pen().color());
         }
-        painter.setTransform(lPath.t,true);
-        painter.drawPath(lPath.path);
-        painter.restore();
+        painter->setTransform(lPath.t,true);
+        painter->drawPath(lPath.path);
+        painter->restore();
     }
-
-    return pixmap;
 }
 
 void DiagramElement::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
+    PaintTimer timer(Type);
     painter->setPen(pen());
     painter->setBrush(brush());
     foreach(Path lPath,lstPaths){
@@ -152,66 +343,458 @@ void DiagramElement::hoverLeaveEvent(QGraphicsSceneHoverEvent *e)
     DiagramItem::hoverLeaveEvent(e);
 }
 
-QList<DiagramElement::Path> DiagramElement::importPathFromFile(const QString &fn)
+/*!
+ * \brief number of element file lookups served from the cache
+ * \return
+ */
+int DiagramElement::cacheHits()
+{
+    return s_cacheHits;
+}
+/*!
+ * \brief number of element file lookups which needed parsing
+ * \return
+ */
+int DiagramElement::cacheMisses()
+{
+    return s_cacheMisses;
+}
+
+/*!
+ * \brief modification time and size of element file
+ * Resources do not change while running.
+ * \param fn
+ * \return
+ */
+QString DiagramElement::fileState(const QString &fn)
 {
-    // open and read in text file
-    QFile loadFile(fn);
-    if (!loadFile.open(QIODevice::ReadOnly)) {
-        qWarning("Couldn't open save file.");
+    if(fn.startsWith(":/")){
+        return QString();
+    }
+    const QFileInfo fi(fn);
+    return QString("%1:%2").arg(fi.lastModified().toMSecsSinceEpoch()).arg(fi.size());
+}
+/*!
+ * \brief parse element file again after it was changed
+ * Placed elements keep their definition until updateDefinition() is called.
+ * \param fn
+ * \return false if the element file was never used or is unreadable
+ */
+bool DiagramElement::reloadDefinition(const QString &fn)
+{
+    const QString old=s_files.value(fn);
+    if(old.isEmpty()){
+        return false;
+    }
+    s_files.remove(fn);
+    DiagramElement element(fn,nullptr);
+    if(element.mHash.isEmpty()){
+        // unreadable, e.g. while being written
+        s_files.insert(fn,old);
+        return false;
+    }
+    return true;
+}
+/*!
+ * \brief switch to current definition of the element file
+ * \return true if the definition changed
+ */
+bool DiagramElement::updateDefinition()
+{
+    const QString hash=s_files.value(mFileName);
+    if(hash.isEmpty() || hash==mHash || !s_definitions.contains(hash)){
+        return false;
+    }
+    prepareGeometryChange();
+    mHash=hash;
+    applyDefinition();
+    DiagramScene::itemGeometryChanged(this);
+    update();
+    return true;
+}
+/*!
+ * \brief declared parameters of a parametric element
+ * \return name -> object with "default", "min", "max" and "type"
+ */
+QJsonObject DiagramElement::parameterDeclarations() const
+{
+    return s_definitions.value(mHash).json["parameters"].toObject();
+}
+/*!
+ * \brief change parameters of a parametric element
+ * Values are limited to the declared range, the geometry is shared with
+ * all elements of the same definition and values.
+ * \param parameters
+ * \return true if the values changed
+ */
+bool DiagramElement::setParameters(const QJsonObject &parameters)
+{
+    if(mHash.isEmpty()){
+        return false;
+    }
+    const QJsonObject values=parameterValues(parameterDeclarations(),parameters);
+    if(values==mParameters){
+        return false;
+    }
+    prepareGeometryChange();
+    mParameters=values;
+    applyDefinition();
+    DiagramScene::itemGeometryChanged(this);
+    update();
+    return true;
+}
+/*!
+ * \brief outline of label text in element definitions
+ * Glyph outlines are expensive to extract, so outlines are shared by all
+ * definitions. The least recently used ones are dropped once the cache
+ * holds more than maxTextPathCost path elements.
+ * \param text
+ * \return outline with baseline at origin
+ */
+QPainterPath DiagramElement::textPath(const QString &text)
+{
+    static const QFont font("Helvetica", 10);
+    const QString key=font.key()+'\n'+text;
+    if(const QPainterPath *cached=s_textPaths.object(key)){
+        return *cached;
+    }
+    auto *path=new QPainterPath;
+    path->addText(0,0,font,text);
+    const QPainterPath result=*path;
+    s_textPaths.insert(key,path,qMax(1,path->elementCount()));
+    return result;
+}
+/*!
+ * \brief number of generated geometries of parametric elements
+ * \return
+ */
+int DiagramElement::variantCount()
+{
+    return s_variants.size();
+}
+/*!
+ * \brief use name and geometry of definition and current parameters
+ */
+void DiagramElement::applyDefinition()
+{
+    // generating may add nested definitions, so no reference is kept
+    const Definition def=s_definitions.value(mHash);
+    mParameters=parameterValues(def.json["parameters"].toObject(),mParameters);
+    setPaths(mParameters.isEmpty() ? def.paths : variantPaths(mHash,mParameters));
+    mName=def.name;
+}
+/*!
+ * \brief complete parameter values
+ * \param declarations parameters of definition
+ * \param values given values
+ * \return values of all declared parameters, limited to their range
+ */
+QJsonObject DiagramElement::parameterValues(const QJsonObject &declarations, const QJsonObject &values)
+{
+    QJsonObject result;
+    for(auto it=declarations.constBegin();it!=declarations.constEnd();++it){
+        const QJsonObject declaration=it.value().toObject();
+        qreal value=values.value(it.key()).toDouble(declaration["default"].toDouble());
+        if(declaration.contains("min")){
+            value=qMax(value,declaration["min"].toDouble());
+        }
+        if(declaration.contains("max")){
+            value=qMin(value,declaration["max"].toDouble());
+        }
+        if(declaration["type"].toString("int")=="int"){
+            result[it.key()]=qRound(value);
+        }else{
+            result[it.key()]=value;
+        }
+    }
+    return result;
+}
+/*!
+ * \brief geometry of definition for parameter values
+ * Geometry is generated once per definition and parameter values and
+ * shared by all elements using them.
+ * \param hash content hash of definition
+ * \param parameters
+ * \return
+ */
+QList<DiagramElement::Path> DiagramElement::variantPaths(const QString &hash, const QJsonObject &parameters)
+{
+    const Definition def=s_definitions.value(hash);
+    const QJsonObject values=parameterValues(def.json["parameters"].toObject(),parameters);
+    if(values.isEmpty()){
+        return def.paths;
+    }
+    // QJsonObject keeps keys sorted, so the key is unique per value tuple
+    const QString key=hash+QString::fromUtf8(QJsonDocument(values).toJson(QJsonDocument::Compact));
+    auto it=s_variants.constFind(key);
+    if(it!=s_variants.constEnd()){
+        ++s_cacheHits;
+        return *it;
+    }
+    if(s_buildingVariants.contains(key)){
+        // a definition using itself, with the same values it would never end
+        const QString cycle=def.fileName+" -> "+def.fileName;
+        if(!s_reportedCycles.contains(cycle)){
+            s_reportedCycles.insert(cycle);
+            qWarning("Cyclic element reference: %s",qPrintable(cycle));
+        }
+        return QList<Path>();
+    }
+    if(s_buildingVariants.size()>=maxVariantDepth){
+        // values changing on each level, e.g. a count counting up
+        qWarning("Element nesting too deep: %s",qPrintable(def.fileName));
         return QList<Path>();
     }
-    QByteArray data = loadFile.readAll();
+    ++s_cacheMisses;
+    s_buildingVariants.insert(key);
+    const QList<Path> paths=createPainterPathFromJSON(def.json,values);
+    s_buildingVariants.remove(key);
+    s_variants.insert(key,paths);
+    return paths;
+}
+/*!
+ * \brief add definition and its nested elements to a document table
+ * \param hash content hash of the definition
+ * \param table hash -> filename and definition
+ */
+void DiagramElement::addDefinition(const QString &hash, QJsonObject &table)
+{
+    if(table.contains(hash)){
+        return;
+    }
+    auto it=s_definitions.constFind(hash);
+    if(it==s_definitions.constEnd()){
+        return;
+    }
+    QJsonObject entry;
+    entry["filename"]=it->fileName;
+    entry["definition"]=it->json;
+    table[hash]=entry;
+    for(const QString &nested:it->nested){
+        addDefinition(nested,table);
+    }
+}
+/*!
+ * \brief take definitions from a document while reading it
+ * Elements and their nested elements are resolved from the table first,
+ * so no file is needed. Call endEmbeddedDefinitions() afterwards.
+ * \param table
+ */
+void DiagramElement::beginEmbeddedDefinitions(const QJsonObject &table)
+{
+    s_embedded=table;
+    s_embeddedFiles.clear();
+    for(auto it=table.constBegin();it!=table.constEnd();++it){
+        s_embeddedFiles.insert(it.value().toObject()["filename"].toString(),it.key());
+    }
+}
+
+void DiagramElement::endEmbeddedDefinitions()
+{
+    s_embedded=QJsonObject();
+    s_embeddedFiles.clear();
+}
 
-    QJsonDocument loadDoc(QJsonDocument::fromJson(data));
+QString DiagramElement::contentHash(const QJsonObject &json)
+{
+    const QByteArray data=QJsonDocument(json).toJson(QJsonDocument::Compact);
+    return QString::fromLatin1(QCryptographicHash::hash(data,QCryptographicHash::Sha1).toHex());
+}
+/*!
+ * \brief files of the elements used by an element definition
+ * Elements inside "repeat" blocks are included.
+ * \param json
+ * \return
+ */
+QStringList DiagramElement::nestedFiles(const QJsonObject &json)
+{
+    QStringList result;
+    collectNestedFiles(json["elements"].toArray(),result);
+    return result;
+}
+
+void DiagramElement::collectNestedFiles(const QJsonArray &array, QStringList &files)
+{
+    for(const QJsonValue &value:array){
+        const QJsonObject jsonObject=value.toObject();
+        const QString type=jsonObject["type"].toString();
+        if(type=="element"){
+            QString fn=":/libs/"+jsonObject["name"].toString();
+            if(!fn.endsWith(".json")){
+                fn+=".json";
+            }
+            if(!files.contains(fn)){
+                files<<fn;
+            }
+        }else if(type=="repeat"){
+            collectNestedFiles(jsonObject["elements"].toArray(),files);
+        }
+    }
+}
+/*!
+ * \brief find or parse element definition
+ * Definitions are shared by content hash, so identical elements are parsed
+ * once. A known hash needs no file at all.
+ * Nested elements are resolved depth first before the definition itself,
+ * so each one is parsed once and the flattened paths are cached with the
+ * definition. References back to an element being resolved are reported
+ * and left out.
+ * \param fn element file
+ * \param hash content hash if known
+ * \return hash of definition, empty if not found or cyclic
+ */
+QString DiagramElement::resolveDefinition(const QString &fn, QString hash)
+{
+    if(hash.isEmpty()){
+        hash=s_embeddedFiles.value(fn);
+    }
+    if(hash.isEmpty()){
+        hash=s_files.value(fn);
+        // file changed since it was read, parse it again like without cache
+        if(!hash.isEmpty() && s_fileStates.value(fn)!=fileState(fn)){
+            hash.clear();
+        }
+    }
+    if(!hash.isEmpty() && s_definitions.contains(hash)){
+        ++s_cacheHits;
+        return hash;
+    }
+    if(s_resolving.contains(fn)){
+        QStringList chain=s_resolving.mid(s_resolving.indexOf(fn));
+        chain<<fn;
+        const QString cycle=chain.join(" -> ");
+        if(!s_reportedCycles.contains(cycle)){
+            s_reportedCycles.insert(cycle);
+            qWarning("Cyclic element reference: %s",qPrintable(cycle));
+        }
+        return QString();
+    }
+    ++s_cacheMisses;
+    QJsonObject json;
+    if(!hash.isEmpty() && s_embedded.contains(hash)){
+        json=s_embedded.value(hash).toObject()["definition"].toObject();
+    }else{
+        // open and read in text file
+        const QString state=fileState(fn);
+        QFile loadFile(fn);
+        if (!loadFile.open(QIODevice::ReadOnly)) {
+            qWarning("Couldn't open save file.");
+            return QString();
+        }
+        json=QJsonDocument::fromJson(loadFile.readAll()).object();
+        hash=contentHash(json);
+        s_files.insert(fn,hash);
+        s_fileStates.insert(fn,state);
+        if(s_definitions.contains(hash)){
+            return hash;
+        }
+    }
 
-    return createPainterPathFromJSON(loadDoc.object());
+    s_resolving<<fn;
+    // dependencies first
+    for(const QString &nested:nestedFiles(json)){
+        resolveDefinition(nested);
+    }
+    Definition def;
+    def.paths=createPainterPathFromJSON(json);
+    def.name=mName;
+    def.fileName=fn;
+    def.json=json;
+    for(const QString &nested:nestedFiles(json)){
+        const QString nestedHash=s_embeddedFiles.value(nested,s_files.value(nested));
+        if(!nestedHash.isEmpty()){
+            def.nested<<nestedHash;
+        }
+    }
+    s_definitions.insert(hash,def);
+    s_resolving.removeLast();
+    return hash;
 }
 
-QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObject json)
+QList<DiagramElement::Path> DiagramElement::importPathFromFile(const QString &fn, const QJsonObject &parameters)
+{
+    const QString hash=resolveDefinition(fn);
+    if(hash.isEmpty()){
+        return QList<Path>();
+    }
+    const QString name=s_definitions[hash].name;
+    const QList<Path> paths=variantPaths(hash,parameters);
+    mName=name;
+    return paths;
+}
+/*!
+ * \brief create paths of element definition
+ * \param json definition
+ * \param parameters values of declared parameters, defaults if missing
+ * \return
+ */
+QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObject json, const QJsonObject &parameters)
 {
     QString elementName=json["name"].toString();
     bool filled=json["filled"].toBool();
     bool dontFill=json["dontFill"].toBool();
     QList<DiagramElement::Path> result;
     QPainterPath path;
-    QJsonArray array=json["elements"].toArray();
+    QHash<QString,qreal> variables;
+    const QJsonObject values=parameterValues(json["parameters"].toObject(),parameters);
+    for(auto it=values.constBegin();it!=values.constEnd();++it){
+        variables.insert(it.key(),it.value().toDouble());
+    }
+    appendElements(json["elements"].toArray(),variables,path,result);
+    Path p;
+    p.path=path;
+    p.filled=filled;
+    p.dontFill=dontFill;
+    result.prepend(p);
+    mName=elementName;
+    return result;
+}
+/*!
+ * \brief add elements of definition to path or result
+ * \param array elements
+ * \param variables parameter values and repeat counters
+ * \param path outline of the element
+ * \param result filled parts and nested elements
+ */
+void DiagramElement::appendElements(const QJsonArray &array, QHash<QString,qreal> &variables, QPainterPath &path, QList<Path> &result)
+{
     for (int index = 0; index < array.size(); ++index) {
         QJsonObject jsonObject = array[index].toObject();
         QString type=jsonObject["type"].toString();
         if(type=="rect") {
-            qreal x0=jsonObject["x0"].toDouble();
-            qreal x1=jsonObject["x1"].toDouble();
-            qreal y0=jsonObject["y0"].toDouble();
-            qreal y1=jsonObject["y1"].toDouble();
+            qreal x0=number(jsonObject["x0"],variables);
+            qreal x1=number(jsonObject["x1"],variables);
+            qreal y0=number(jsonObject["y0"],variables);
+            qreal y1=number(jsonObject["y1"],variables);
             path.moveTo(QPointF(x0,y0));
             path.addRect(x0,y0,x1-x0,y1-y0);
         }
         if(type=="circle") {
-            qreal x0=jsonObject["x0"].toDouble();
-            qreal y0=jsonObject["y0"].toDouble();
+            qreal x0=number(jsonObject["x0"],variables);
+            qreal y0=number(jsonObject["y0"],variables);
             qreal rx,ry;
             if(jsonObject.contains("r")){
-                rx=jsonObject["r"].toDouble();
+                rx=number(jsonObject["r"],variables);
                 ry=rx;
             }else{
-                rx=jsonObject["rx"].toDouble();
-                ry=jsonObject["ry"].toDouble();
+                rx=number(jsonObject["rx"],variables);
+                ry=number(jsonObject["ry"],variables);
             }
             QPointF p_center(x0,y0);
             path.moveTo(p_center);
             path.addEllipse(p_center,rx,ry);
         }
         if(type=="line") {
-            qreal x0=jsonObject["x0"].toDouble();
-            qreal x1=jsonObject["x1"].toDouble();
-            qreal y0=jsonObject["y0"].toDouble();
-            qreal y1=jsonObject["y1"].toDouble();
+            qreal x0=number(jsonObject["x0"],variables);
+            qreal x1=number(jsonObject["x1"],variables);
+            qreal y0=number(jsonObject["y0"],variables);
+            qreal y1=number(jsonObject["y1"],variables);
             path.moveTo(x0,y0);
             path.lineTo(x1,y1);
         }
         if(type=="lineTo") {
-            qreal x0=jsonObject["x"].toDouble();
-            qreal y0=jsonObject["y"].toDouble();
+            qreal x0=number(jsonObject["x"],variables);
+            qreal y0=number(jsonObject["y"],variables);
             path.lineTo(x0,y0);
         }
         if(type=="polygon") {
@@ -219,8 +802,8 @@ QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObjec
             QJsonArray jsonPoints=jsonObject["points"].toArray();
             for(int i=0;i<jsonPoints.size();++i){
                 QJsonObject jsonElement=jsonPoints[i].toObject();
-                qreal x=jsonElement["x"].toDouble();
-                qreal y=jsonElement["y"].toDouble();
+                qreal x=number(jsonElement["x"],variables);
+                qreal y=number(jsonElement["y"],variables);
                 lst<<QPointF(x,y);
             }
             QPolygonF polygon{lst};
@@ -232,8 +815,8 @@ QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObjec
             QJsonArray jsonPoints=jsonObject["points"].toArray();
             for(int i=0;i<jsonPoints.size();++i){
                 QJsonObject jsonElement=jsonPoints[i].toObject();
-                qreal x=jsonElement["x"].toDouble();
-                qreal y=jsonElement["y"].toDouble();
+                qreal x=number(jsonElement["x"],variables);
+                qreal y=number(jsonElement["y"],variables);
                 lst<<QPointF(x,y);
             }
             for(int i=1;i<lst.length();++i){
@@ -242,53 +825,53 @@ QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObjec
             }
         }
         if(type=="arc") {
-            qreal x=jsonObject["x"].toDouble();
-            qreal y=jsonObject["y"].toDouble();
-            qreal rx=jsonObject["rx"].toDouble();
-            qreal ry=jsonObject["ry"].toDouble();
-            qreal angle=jsonObject["angle"].toDouble();
-            qreal length=jsonObject["length"].toDouble();
+            qreal x=number(jsonObject["x"],variables);
+            qreal y=number(jsonObject["y"],variables);
+            qreal rx=number(jsonObject["rx"],variables);
+            qreal ry=number(jsonObject["ry"],variables);
+            qreal angle=number(jsonObject["angle"],variables);
+            qreal length=number(jsonObject["length"],variables);
             path.arcMoveTo(x-rx,y-ry,2*rx,2*ry,angle);
             path.arcTo(x-rx,y-ry,2*rx,2*ry,angle,length);
         }
         if(type=="arcTo") {
-            qreal x=jsonObject["x"].toDouble();
-            qreal y=jsonObject["y"].toDouble();
-            qreal rx=jsonObject["rx"].toDouble();
-            qreal ry=jsonObject["ry"].toDouble();
-            qreal angle=jsonObject["angle"].toDouble();
-            qreal length=jsonObject["length"].toDouble();
+            qreal x=number(jsonObject["x"],variables);
+            qreal y=number(jsonObject["y"],variables);
+            qreal rx=number(jsonObject["rx"],variables);
+            qreal ry=number(jsonObject["ry"],variables);
+            qreal angle=number(jsonObject["angle"],variables);
+            qreal length=number(jsonObject["length"],variables);
             path.arcTo(x-rx,y-ry,2*rx,2*ry,angle,length);
         }
         if(type=="quad") {
-            qreal x0=jsonObject["x0"].toDouble();
-            qreal x1=jsonObject["x1"].toDouble();
-            qreal y0=jsonObject["y0"].toDouble();
-            qreal y1=jsonObject["y1"].toDouble();
-            qreal cx=jsonObject["cx"].toDouble();
-            qreal cy=jsonObject["cy"].toDouble();
+            qreal x0=number(jsonObject["x0"],variables);
+            qreal x1=number(jsonObject["x1"],variables);
+            qreal y0=number(jsonObject["y0"],variables);
+            qreal y1=number(jsonObject["y1"],variables);
+            qreal cx=number(jsonObject["cx"],variables);
+            qreal cy=number(jsonObject["cy"],variables);
             path.moveTo(x0,y0);
             path.quadTo(cx,cy,x1,y1);
         }
         if(type=="cubic") {
-            qreal x0=jsonObject["x0"].toDouble();
-            qreal x1=jsonObject["x1"].toDouble();
-            qreal y0=jsonObject["y0"].toDouble();
-            qreal y1=jsonObject["y1"].toDouble();
-            qreal cx0=jsonObject["cx0"].toDouble();
-            qreal cy0=jsonObject["cy0"].toDouble();
-            qreal cx1=jsonObject["cx1"].toDouble();
-            qreal cy1=jsonObject["cy1"].toDouble();
+            qreal x0=number(jsonObject["x0"],variables);
+            qreal x1=number(jsonObject["x1"],variables);
+            qreal y0=number(jsonObject["y0"],variables);
+            qreal y1=number(jsonObject["y1"],variables);
+            qreal cx0=number(jsonObject["cx0"],variables);
+            qreal cy0=number(jsonObject["cy0"],variables);
+            qreal cx1=number(jsonObject["cx1"],variables);
+            qreal cy1=number(jsonObject["cy1"],variables);
             path.moveTo(x0,y0);
             path.cubicTo(cx0,cy0,cx1,cy1,x1,y1);
         }
         if(type=="cubicTo") {
-            qreal x1=jsonObject["x1"].toDouble();
-            qreal y1=jsonObject["y1"].toDouble();
-            qreal cx0=jsonObject["cx0"].toDouble();
-            qreal cy0=jsonObject["cy0"].toDouble();
-            qreal cx1=jsonObject["cx1"].toDouble();
-            qreal cy1=jsonObject["cy1"].toDouble();
+            qreal x1=number(jsonObject["x1"],variables);
+            qreal y1=number(jsonObject["y1"],variables);
+            qreal cx0=number(jsonObject["cx0"],variables);
+            qreal cy0=number(jsonObject["cy0"],variables);
+            qreal cx1=number(jsonObject["cx1"],variables);
+            qreal cy1=number(jsonObject["cy1"],variables);
             path.cubicTo(cx0,cy0,cx1,cy1,x1,y1);
         }
         if(type=="close") {
@@ -296,25 +879,30 @@ QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObjec
         }
         if(type=="text"){
             Path localPath;
-            qreal x=jsonObject["x"].toDouble();
-            qreal y=jsonObject["y"].toDouble();
+            qreal x=number(jsonObject["x"],variables);
+            qreal y=number(jsonObject["y"],variables);
             QString text=jsonObject["text"].toString();
-            QFont serifFont("Helvetica", 10);
-            localPath.path.addText(x,y,serifFont,text);
+            localPath.path=textPath(text).translated(x,y);
             localPath.filled=true;
             result<<localPath;
         }
         if(type=="element"){
-            qreal x=jsonObject["x"].toDouble();
-            qreal y=jsonObject["y"].toDouble();
-            qreal scale=jsonObject["scale"].toDouble(1.);
-            qreal rotate=jsonObject["rotate"].toDouble(0.);
+            qreal x=number(jsonObject["x"],variables);
+            qreal y=number(jsonObject["y"],variables);
+            qreal scale=number(jsonObject["scale"],variables,1.);
+            qreal rotate=number(jsonObject["rotate"],variables);
             QString fn=jsonObject["name"].toString();
             fn=":/libs/"+fn;
             if(!fn.endsWith(".json")){
                 fn+=".json";
             }
-            QList<Path> local=importPathFromFile(fn);
+            // values of nested parameters may use our parameters
+            QJsonObject nestedParameters;
+            const QJsonObject jsonParameters=jsonObject["parameters"].toObject();
+            for(auto it=jsonParameters.constBegin();it!=jsonParameters.constEnd();++it){
+                nestedParameters[it.key()]=number(it.value(),variables);
+            }
+            QList<Path> local=importPathFromFile(fn,nestedParameters);
             for(Path &elem:local){
                 elem.t.translate(x,y);
                 elem.t.scale(scale,scale);
@@ -322,30 +910,32 @@ QList<DiagramElement::Path> DiagramElement::createPainterPathFromJSON(QJsonObjec
             }
             result<<local;
         }
+        if(type=="repeat"){
+            // elements for var=0..count-1
+            const QString var=jsonObject["var"].toString("i");
+            const int count=qBound(0,qRound(number(jsonObject["count"],variables)),maxRepeat);
+            const qreal outer=variables.value(var);
+            const bool shadowed=variables.contains(var);
+            for(int i=0;i<count;++i){
+                variables[var]=i;
+                appendElements(jsonObject["elements"].toArray(),variables,path,result);
+            }
+            if(shadowed){
+                variables[var]=outer;
+            }else{
+                variables.remove(var);
+            }
+        }
     }
-    Path p;
-    p.path=path;
-    p.filled=filled;
-    p.dontFill=dontFill;
-    result.prepend(p);
-    mName=elementName;
-    return result;
 }
 
 DiagramElement::DiagramElement(const QJsonObject &json, QMenu *contextMenu):DiagramItem(json,contextMenu)
 {
     mFileName=json["filename"].toString();
     mName=json["name"].toString();
-    lstPaths=importPathFromFile(mFileName);
-    if(!lstPaths.isEmpty()){
-        QPainterPath p;
-        for(const auto &lp:lstPaths){
-            p|=lp.path;
-        }
-        setPath(p);
-        setFlag(QGraphicsItem::ItemIsMovable, true);
-        setFlag(QGraphicsItem::ItemIsSelectable, true);
-        setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
-        setAcceptHoverEvents(true);
+    mParameters=json["parameters"].toObject();
+    mHash=resolveDefinition(mFileName,json["element"].toString());
+    if(!mHash.isEmpty()){
+        applyDefinition();
     }
 }
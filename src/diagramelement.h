@@ -2,6 +2,11 @@
 #define DIAGRAMELEMENT_H
 
 #include "diagramitem.h"
+#include <QCache>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QSet>
 
 class DiagramElement : public DiagramItem
 {
@@ -15,6 +20,7 @@ public:
     DiagramItem* copy() override;
     void write(QJsonObject &obj) override;
     QPixmap image() const;
+    void paintIcon(QPainter *painter) const;
     DiagramType diagramType() const
         { return Element; }
     int type() const override
@@ -25,6 +31,23 @@ public:
     QString getFileName() {
         return mFileName;
     }
+    QString getHash() const {
+        return mHash;
+    }
+    QJsonObject parameterDeclarations() const;
+    QJsonObject parameters() const {
+        return mParameters;
+    }
+    bool setParameters(const QJsonObject &parameters);
+    static int cacheHits();
+    static int cacheMisses();
+    static int variantCount();
+    static QPainterPath textPath(const QString &text);
+    bool updateDefinition();
+    static bool reloadDefinition(const QString &fn);
+    static void addDefinition(const QString &hash, QJsonObject &table);
+    static void beginEmbeddedDefinitions(const QJsonObject &table);
+    static void endEmbeddedDefinitions();
 protected:
     struct Path {
         QPainterPath path;
@@ -39,10 +62,54 @@ protected:
 
     QString mFileName;
     QString mName;
+    QString mHash;
+    // values of parametric elements
+    QJsonObject mParameters;
     QList<Path> lstPaths;
 
-    QList<Path> importPathFromFile(const QString &fn);
-    QList<Path> createPainterPathFromJSON(QJsonObject json);
+    void setPaths(const QList<Path> &paths);
+    void applyDefinition();
+    QString resolveDefinition(const QString &fn, QString hash=QString());
+    QList<Path> variantPaths(const QString &hash, const QJsonObject &parameters);
+    QList<Path> importPathFromFile(const QString &fn, const QJsonObject &parameters=QJsonObject());
+    QList<Path> createPainterPathFromJSON(QJsonObject json, const QJsonObject &parameters=QJsonObject());
+    void appendElements(const QJsonArray &array, QHash<QString,qreal> &variables, QPainterPath &path, QList<Path> &result);
+
+private:
+    struct Definition {
+        QString name;
+        QList<Path> paths;
+        QString fileName;
+        QJsonObject json;
+        // hashes of nested elements
+        QStringList nested;
+    };
+    static QString contentHash(const QJsonObject &json);
+    static QJsonObject parameterValues(const QJsonObject &declarations, const QJsonObject &values);
+    static QStringList nestedFiles(const QJsonObject &json);
+    static void collectNestedFiles(const QJsonArray &array, QStringList &files);
+    static QString fileState(const QString &fn);
+    // parsed element definitions by content hash, shared by all instances
+    static QHash<QString,Definition> s_definitions;
+    // element file -> content hash
+    static QHash<QString,QString> s_files;
+    // element file -> state when read, see fileState()
+    static QHash<QString,QString> s_fileStates;
+    // generated geometry of parametric definitions by hash and values
+    static QHash<QString,QList<Path>> s_variants;
+    // glyph outlines of label texts, bounded by number of path elements
+    static const int maxTextPathCost=200000;
+    static QCache<QString,QPainterPath> s_textPaths;
+    // element files being resolved, innermost last
+    static QStringList s_resolving;
+    static QSet<QString> s_reportedCycles;
+    // keys of s_variants being generated
+    static QSet<QString> s_buildingVariants;
+    // definitions embedded in the document being read, by hash and file
+    static QJsonObject s_embedded;
+    static QHash<QString,QString> s_embeddedFiles;
+    static int s_cacheHits;
+    static int s_cacheMisses;
 };
 
 #endif // DIAGRAMELEMENT_H
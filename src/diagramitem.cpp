@@ -49,6 +49,8 @@
 ****************************************************************************/
 
 #include "diagramitem.h"
+#include "paintstatistics.h"
+#include "diagramscene.h"
 
 #include <QGraphicsScene>
 #include <QGraphicsSceneContextMenuEvent>
@@ -170,8 +172,20 @@ void DiagramItem::contextMenuEvent(QGraphicsSceneContextMenuEvent *event)
     }
 }
 
+void DiagramItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    PaintTimer timer(type());
+    QGraphicsPathItem::paint(painter,option,widget);
+}
+
+DiagramItem::~DiagramItem()
+{
+    DiagramScene::itemDestroyed(this);
+}
+
 QVariant DiagramItem::itemChange(GraphicsItemChange change, const QVariant &value)
 {
+    DiagramScene::itemChanged(this,change);
 
     return value;
 }
@@ -73,6 +73,7 @@ public:
     DiagramItem(const QJsonObject &json, QMenu *contextMenu);
 
     DiagramItem(const DiagramItem& diagram);//copy constructor
+    ~DiagramItem() override;
 
     virtual DiagramItem* copy();
     virtual void write(QJsonObject &obj);
@@ -90,6 +91,7 @@ public:
 protected:
     void contextMenuEvent(QGraphicsSceneContextMenuEvent *event) override;
     QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
 
     QMenu *myContextMenu;
 
@@ -5,6 +5,7 @@
 
 #include "diagrampathitem.h"
 #include "diagramscene.h"
+#include "paintstatistics.h"
 
 DiagramPathItem::DiagramPathItem(DiagramType diagramType, QMenu *contextMenu,
              QGraphicsItem *parent)
@@ -291,9 +292,15 @@ void DiagramPathItem::updateLast(const QPointF point)
     }
 }
 
+DiagramPathItem::~DiagramPathItem()
+{
+    DiagramScene::itemDestroyed(this);
+}
+
 QVariant DiagramPathItem::itemChange(GraphicsItemChange change,
                      const QVariant &value)
 {
+    DiagramScene::itemChanged(this,change);
     if (change == QGraphicsItem::ItemPositionChange) {
         //foreach (Arrow *arrow, arrows) {
         //    arrow->updatePosition();
@@ -342,6 +349,7 @@ void DiagramPathItem::write(QJsonObject &json)
 void DiagramPathItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *,
            QWidget *)
 {
+     PaintTimer timer(Type);
      painter->setPen(pen());
      painter->setBrush(Qt::NoBrush);
      painter->drawPath(getPath());
@@ -17,6 +17,7 @@ public:
             QGraphicsItem *parent);//constructor fuer Vererbung
     DiagramPathItem(const QJsonObject &json, QMenu *contextMenu);
     DiagramPathItem(const DiagramPathItem& diagram);//copy constructor
+    ~DiagramPathItem() override;
 
     DiagramPathItem* copy();
     void write(QJsonObject &json);
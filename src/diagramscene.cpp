@@ -50,8 +50,10 @@
 
 #include "diagramscene.h"
 #include <math.h>
+#include <algorithm>
 
 #include <QGraphicsSceneMouseEvent>
+#include <QStyleOptionGraphicsItem>
 #include <QTextCursor>
 #include <QXmlStreamWriter>
 #include <QJsonObject>
@@ -60,9 +62,41 @@
 #include <QPainter>
 #include <QtGui>
 
+// canvas of a new document, the scene rect grows beyond as needed
+static const QRectF defaultSceneRect(0,0,5000,5000);
+// free space kept around the content when the scene rect grows
+static const qreal sceneRectMargin=2000.0;
+// size of preview images in document headers
+static const int previewSize=256;
+// header line including preview is read up to this size
+static const qint64 maxHeaderSize=4*1024*1024;
+
+/*!
+ * \brief render rect of scene scaled down to fit size
+ * \param scene
+ * \param rect
+ * \param size maximum width and height
+ * \return null image for an empty rect
+ */
+static QImage previewImage(QGraphicsScene *scene, QRectF rect, int size)
+{
+    if(rect.isEmpty()){
+        return QImage();
+    }
+    rect.adjust(-1,-1,1,1);
+    const qreal scale=qMin(1.,size/qMax(rect.width(),rect.height()));
+    QImage image(qCeil(rect.width()*scale),qCeil(rect.height()*scale),QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    scene->render(&painter,QRectF(),rect);
+    painter.end();
+    return image;
+}
+
 //! [0]
 DiagramScene::DiagramScene(QMenu *itemMenu, QObject *parent)
-    : QGraphicsScene(parent)
+    : QGraphicsScene(parent), m_pendingMove(QEvent::GraphicsSceneMouseMove)
 {
     myItemMenu = itemMenu;
     myMode = MoveItem;
@@ -76,6 +110,18 @@ DiagramScene::DiagramScene(QMenu *itemMenu, QObject *parent)
     myDx=0.0;
     myDy=0.0;
     maxZ=0;
+    minZ=0;
+    m_bulkUpdate=0;
+    m_bulkIndexMethod=BspTreeIndex;
+    m_contentBoundsDirty=false;
+    m_growOnly=false;
+    m_shrinkPending=false;
+    m_embedElements=false;
+    m_layers<<QString();
+    setSceneRect(defaultSceneRect);
+    m_sceneRectTimer.setSingleShot(true);
+    m_sceneRectTimer.setInterval(0);
+    connect(&m_sceneRectTimer,&QTimer::timeout,this,&DiagramScene::growSceneRect);
     myItemColor = Qt::white;
     myTextColor = Qt::black;
     myLineColor = Qt::black;
@@ -95,12 +141,63 @@ DiagramScene::DiagramScene(QMenu *itemMenu, QObject *parent)
     myCursor.setPen(QPen(Qt::gray));
     myCursor.setZValue(10.0);
     addItem(&myCursor);
+    // process at most one mouse move per display frame
+    m_movePending=false;
+    m_dragDeltaValid=false;
+    m_dragPreview=nullptr;
+    m_selectionDirty=true;
+    m_bulkSelection=0;
+    // z values are renormalized when idle
+    m_zOrderTimer.setSingleShot(true);
+    m_zOrderTimer.setInterval(500);
+    connect(&m_zOrderTimer,&QTimer::timeout,this,&DiagramScene::renormalizeZ);
+    m_textSelectionQueued=false;
+    connect(this,&QGraphicsScene::selectionChanged,this,[this](){ m_selectionDirty=true; });
+    qreal rate=60.0;
+    if(QGuiApplication::primaryScreen()){
+        rate=qMax(QGuiApplication::primaryScreen()->refreshRate(),1.0);
+    }
+    m_moveTimer.setSingleShot(true);
+    m_moveTimer.setInterval(qBound(4,qRound(1000.0/rate),40));
+    connect(&m_moveTimer,&QTimer::timeout,this,&DiagramScene::flushMouseMove);
+}
+DiagramScene::~DiagramScene()
+{
+    // items of hidden layers are not in the scene, it does not delete them
+    for(const QList<QGraphicsItem*> &lst:m_hiddenItems){
+        qDeleteAll(lst);
+    }
+}
+/*!
+ * \brief copy mouse event data for deferred processing
+ * \param from
+ * \param to
+ */
+static void copyMouseEvent(const QGraphicsSceneMouseEvent *from, QGraphicsSceneMouseEvent *to)
+{
+    to->setWidget(from->widget());
+    to->setPos(from->pos());
+    to->setScenePos(from->scenePos());
+    to->setScreenPos(from->screenPos());
+    to->setLastPos(from->lastPos());
+    to->setLastScenePos(from->lastScenePos());
+    to->setLastScreenPos(from->lastScreenPos());
+    for(Qt::MouseButton button:{Qt::LeftButton,Qt::RightButton,Qt::MiddleButton}){
+        to->setButtonDownPos(button,from->buttonDownPos(button));
+        to->setButtonDownScenePos(button,from->buttonDownScenePos(button));
+        to->setButtonDownScreenPos(button,from->buttonDownScreenPos(button));
+    }
+    to->setButtons(from->buttons());
+    to->setButton(from->button());
+    to->setModifiers(from->modifiers());
+    to->setFlags(from->flags());
+    to->setAccepted(false);
 }
 
 void DiagramScene::setLineColor(const QColor &color)
 {
     myLineColor = color;
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         DiagramItem *item = dynamic_cast<DiagramItem *>(elem);
         if(item){
             QPen pen=item->pen();
@@ -119,7 +216,7 @@ void DiagramScene::setLineColor(const QColor &color)
 void DiagramScene::setTextColor(const QColor &color)
 {
     myTextColor = color;
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         DiagramTextItem *item = dynamic_cast<DiagramTextItem *>(elem);
         if(item)
             item->setDefaultTextColor(myTextColor);
@@ -129,7 +226,7 @@ void DiagramScene::setTextColor(const QColor &color)
 void DiagramScene::setItemColor(const QColor &color)
 {
     myItemColor = color;
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         DiagramItem *item = dynamic_cast<DiagramItem *>(elem);
         if(item){
             item->setBrush(myItemColor);
@@ -140,12 +237,13 @@ void DiagramScene::setItemColor(const QColor &color)
 void DiagramScene::setLineWidth(const int w)
 {
     myLineWidth = w;
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         QGraphicsPathItem *item = dynamic_cast<QGraphicsPathItem *>(elem);
         if(item){
             QPen pen=item->pen();
             pen.setWidth(w);
             item->setPen(pen);
+            trackBounds(item);
         }
     }
 }
@@ -153,7 +251,7 @@ void DiagramScene::setLineWidth(const int w)
 void DiagramScene::setLinePattern(const Qt::PenStyle style)
 {
     myPenStyle=style;
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         QGraphicsPathItem *item = dynamic_cast<QGraphicsPathItem *>(elem);
         if(item){
             QPen pen=item->pen();
@@ -169,7 +267,7 @@ void DiagramScene::setLinePattern(const Qt::PenStyle style)
 void DiagramScene::setTextAlignment(const Qt::Alignment alignment)
 {
     m_textAlignment = alignment;
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         DiagramTextItem *item = dynamic_cast<DiagramTextItem *>(elem);
         if(item){
             item->setAlignment(alignment);
@@ -194,10 +292,12 @@ void DiagramScene::setFont(const QFont &font)
 {
     myFont = font;
 
-    foreach(QGraphicsItem *elem,selectedItems()){
+    foreach(QGraphicsItem *elem,selection()){
         DiagramTextItem *item = qgraphicsitem_cast<DiagramTextItem *>(elem);
-        if (item)
+        if (item){
             item->setFont(myFont);
+            trackBounds(item);
+        }
     }
 }
 
@@ -241,7 +341,7 @@ DiagramTextItem *DiagramScene::makeTextItem(QGraphicsItem *item)
     connect(textItem, &DiagramTextItem::receivedFocus,
             this, &DiagramScene::editorReceivedFocus);
     connect(textItem, &DiagramTextItem::selectedChange,
-            this, &DiagramScene::itemSelected);
+            this, &DiagramScene::textItemSelected);
     //addItem(textItem);
     textItem->setParentItem(item);
     textItem->setDefaultTextColor(myTextColor);
@@ -251,46 +351,360 @@ DiagramTextItem *DiagramScene::makeTextItem(QGraphicsItem *item)
 }
 /*!
  * \brief load user element
- * User element is basically a qdia save file with is inserted as new item
+ * User element is basically a qdia save file. It is read once per document
+ * and stored as symbol definition, placed elements only reference it.
  * \param fn
  * \return
  */
-DiagramItem *DiagramScene::load_userElement(const QString &fn)
+DiagramSymbol *DiagramScene::load_userElement(const QString &fn)
 {
-    QFile file(fn);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)){
-        return nullptr;
-    }
-    QByteArray data = file.readAll();
+    DiagramSymbol::DefinitionPtr def=m_symbols.value(m_symbolFiles.value(fn));
+    if(!def){
+        QFile file(fn);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+            return nullptr;
+        }
+        QJsonDocument doc=QJsonDocument::fromJson(file.readAll());
+        DiagramElement::beginEmbeddedDefinitions(doc.object()["elements"].toObject());
+        readSymbols(doc);
 
-    auto *element=new DiagramItem(nullptr,nullptr);
-    element->setFlag(QGraphicsItem::ItemIsMovable);
-    element->setFlag(QGraphicsItem::ItemIsSelectable);
+        // first item is the origin of the symbol
+        QList<QGraphicsItem*> lst=createItems(documentItems(doc));
+        DiagramElement::endEmbeddedDefinitions();
+        QPointF offset;
+        QJsonArray array;
+        for(int i=0;i<lst.size();++i){
+            QGraphicsItem *item=lst.at(i);
+            if(i==0){
+                offset=item->pos();
+            }
+            if(item->type()==DiagramTextItem::Type){
+                DiagramTextItem *ti=qgraphicsitem_cast<DiagramTextItem*>(item);
+                QPointF m_offset=ti->getLastOffset();
+                ti->setCorrectedPos(item->pos()-offset-m_offset);
+            }else{
+                item->setPos(item->pos()-offset);
+            }
+            item->setFlag(QGraphicsItem::ItemIsSelectable,false);
+            item->setFlag(QGraphicsItem::ItemIsMovable,false);
+            addElementToJSON(item,array);
+        }
+        qDeleteAll(lst);
 
-    QJsonDocument doc=QJsonDocument::fromJson(data);
-    QJsonArray array=doc.array();
-    QPointF offset;
-    QRectF rect;
-    for(int i=0;i<array.size();++i){
-        QJsonObject json=array[i].toObject();
-        QGraphicsItem *item=getElementFromJSON(json);
-        if(i==0){
-            offset=item->pos();
+        // same name for a different element gets a number
+        const QString base=QFileInfo(fn).completeBaseName();
+        QString name=base;
+        for(int n=2;m_symbols.contains(name) && m_symbols.value(name)->items!=array;++n){
+            name=QString("%1 %2").arg(base).arg(n);
         }
-        if(item->type()==DiagramTextItem::Type){
-            DiagramTextItem *ti=qgraphicsitem_cast<DiagramTextItem*>(item);
-            QPointF m_offset=ti->getLastOffset();
-            ti->setCorrectedPos(item->pos()-offset-m_offset);
-        }else{
-            item->setPos(item->pos()-offset);
+        def=m_symbols.value(name);
+        if(!def){
+            def=defineSymbol(name,array);
+        }
+        m_symbolFiles.insert(fn,name);
+    }
+    return new DiagramSymbol(def,myItemMenu);
+}
+/*!
+ * \brief symbol definition of the document
+ * \param name
+ * \return null if unknown
+ */
+DiagramSymbol::DefinitionPtr DiagramScene::symbolDefinition(const QString &name) const
+{
+    return m_symbols.value(name);
+}
+/*!
+ * \brief forget symbol definitions, for a new document
+ * Call after clear().
+ */
+void DiagramScene::resetSymbols()
+{
+    m_symbols.clear();
+    m_symbolFiles.clear();
+}
+/*!
+ * \brief element or user element file was changed on disk
+ * Placed elements of the file switch to the new definition. Placed user
+ * elements keep the symbol stored in the document, only new placements
+ * read the file again.
+ * \param fn
+ */
+void DiagramScene::libraryFileChanged(const QString &fn)
+{
+    m_symbolFiles.remove(fn);
+    if(!DiagramElement::reloadDefinition(fn)){
+        // never used, nothing to update
+        return;
+    }
+    QList<QGraphicsItem*> lst=items();
+    for(const QList<QGraphicsItem*> &hidden:m_hiddenItems){
+        for(QGraphicsItem *item:hidden){
+            lst<<item;
+            // stashed items are not in the scene, collect their children too
+            QList<QGraphicsItem*> children=item->childItems();
+            while(!children.isEmpty()){
+                QGraphicsItem *child=children.takeLast();
+                lst<<child;
+                children<<child->childItems();
+            }
+        }
+    }
+    bool changed=false;
+    for(QGraphicsItem *item:lst){
+        if(item->type()!=DiagramElement::Type){
+            continue;
+        }
+        DiagramElement *element=qgraphicsitem_cast<DiagramElement*>(item);
+        if(element->getFileName()==fn && element->updateDefinition()){
+            changed=true;
+        }
+    }
+    if(changed){
+        takeSnapshot();
+    }
+}
+/*!
+ * \brief save element definitions with the document
+ * Such documents do not depend on the element library.
+ * \param embed
+ */
+void DiagramScene::setEmbedElements(bool embed)
+{
+    m_embedElements=embed;
+}
+
+bool DiagramScene::embedElements() const
+{
+    return m_embedElements;
+}
+/*!
+ * \brief add table of the used element definitions to a document
+ * Each definition is stored once, referenced by its content hash.
+ * \param doc
+ * \return
+ */
+QJsonDocument DiagramScene::embedElementDefinitions(const QJsonDocument &doc) const
+{
+    QJsonObject root;
+    if(doc.isArray()){
+        root["items"]=doc.array();
+    }else{
+        root=doc.object();
+    }
+    QSet<QString> hashes;
+    collectElements(root["items"].toArray(),hashes);
+    const QJsonObject symbols=root["symbols"].toObject();
+    for(const QJsonValue &symbol:symbols){
+        collectElements(symbol.toObject()["items"].toArray(),hashes);
+    }
+    QJsonObject table;
+    for(const QString &hash:hashes){
+        DiagramElement::addDefinition(hash,table);
+    }
+    if(!table.isEmpty()){
+        root["elements"]=table;
+    }
+    return QJsonDocument(root);
+}
+/*!
+ * \brief find element hashes in items and their children
+ * \param items
+ * \param hashes
+ */
+void DiagramScene::collectElements(const QJsonArray &items, QSet<QString> &hashes)
+{
+    for(const QJsonValue &value:items){
+        const QJsonObject json=value.toObject();
+        if(json["type"].toInt()==DiagramElement::Type && json.contains("element")){
+            hashes.insert(json["element"].toString());
+        }
+        collectElements(json["children"].toArray(),hashes);
+    }
+}
+/*!
+ * \brief create symbol definition from items
+ * The items are built once to record their drawing and bounds.
+ * \param name
+ * \param items relative to symbol origin
+ * \return
+ */
+DiagramSymbol::DefinitionPtr DiagramScene::defineSymbol(const QString &name, const QJsonArray &items)
+{
+    auto def=QSharedPointer<DiagramSymbol::Definition>::create();
+    def->name=name;
+    def->items=items;
+    QGraphicsScene recorder;
+    for(QGraphicsItem *item:createItems(items)){
+        recorder.addItem(item);
+        def->bounds|=item->sceneBoundingRect();
+    }
+    if(!def->bounds.isEmpty()){
+        QPainter painter(&def->picture);
+        recorder.render(&painter,def->bounds,def->bounds);
+    }
+    m_symbols.insert(name,def);
+    return def;
+}
+/*!
+ * \brief stand-in for a symbol missing in the document
+ * It shows the name in a dashed box. The definition is not stored with
+ * the scene and never written, so the instance keeps referring to the
+ * symbol by name.
+ * \param name
+ * \return
+ */
+DiagramSymbol::DefinitionPtr DiagramScene::placeholderSymbol(const QString &name)
+{
+    auto def=QSharedPointer<DiagramSymbol::Definition>::create();
+    def->name=name;
+    def->placeholder=true;
+    def->bounds=QRectF(0,0,qMax(40.0,QFontMetricsF(font()).horizontalAdvance(name)+10),20);
+    QPainter painter(&def->picture);
+    painter.setPen(QPen(Qt::red,0,Qt::DashLine));
+    painter.drawRect(def->bounds);
+    painter.setPen(Qt::red);
+    painter.drawText(def->bounds,Qt::AlignCenter,name);
+    return def;
+}
+/*!
+ * \brief define the symbols stored in a document
+ * Definitions already known with the same items are kept.
+ * \param doc
+ */
+void DiagramScene::readSymbols(const QJsonDocument &doc)
+{
+    const QJsonObject symbols=doc.object()["symbols"].toObject();
+    QHash<QString,bool> done;
+    QStringList visiting;
+    for(auto it=symbols.constBegin();it!=symbols.constEnd();++it){
+        readSymbol(symbols,it.key(),done,visiting);
+    }
+}
+/*!
+ * \brief define one symbol of a document after the symbols it uses
+ * A symbol is recorded with the drawing of the symbols inside, so it is
+ * defined again when one of them changed.
+ * \param symbols all symbols of the document
+ * \param name
+ * \param done symbols already read, true if (re)defined
+ * \param visiting chain of symbols being read, guards against cycles
+ * \return true if the definition changed
+ */
+bool DiagramScene::readSymbol(const QJsonObject &symbols, const QString &name, QHash<QString, bool> &done, QStringList &visiting)
+{
+    auto known=done.constFind(name);
+    if(known!=done.constEnd()){
+        return known.value();
+    }
+    if(!symbols.contains(name)){
+        return false;
+    }
+    if(visiting.contains(name)){
+        qWarning("Cyclic symbol reference: %s",qPrintable((visiting+QStringList(name)).join(" -> ")));
+        return false;
+    }
+    const QJsonArray items=symbols[name].toObject()["items"].toArray();
+    QSet<QString> names;
+    collectSymbolNames(items,names);
+    bool changed=false;
+    visiting<<name;
+    for(const QString &inner:names){
+        changed|=readSymbol(symbols,inner,done,visiting);
+    }
+    visiting.removeLast();
+    DiagramSymbol::DefinitionPtr def=m_symbols.value(name);
+    if(changed || !def || def->items!=items){
+        defineSymbol(name,items);
+        changed=true;
+    }
+    done.insert(name,changed);
+    return changed;
+}
+/*!
+ * \brief collect names of the symbols used in json items
+ * \param items
+ * \param names
+ */
+void DiagramScene::collectSymbolNames(const QJsonArray &items, QSet<QString> &names)
+{
+    for(const QJsonValue &value:items){
+        const QJsonObject json=value.toObject();
+        if(json["type"].toInt()==DiagramSymbol::Type){
+            names.insert(json["symbol"].toString());
         }
-        item->setFlag(QGraphicsItem::ItemIsSelectable,false);
-        item->setFlag(QGraphicsItem::ItemIsMovable,false);
-        item->setParentItem(element);
-        rect=rect.united(item->boundingRect().translated(item->pos()));
+        collectSymbolNames(json["children"].toArray(),names);
+    }
+}
+/*!
+ * \brief items of a document
+ * Documents with symbols are an object with "symbols" and "items", plain
+ * documents just an array of items.
+ * \param doc
+ * \return
+ */
+QJsonArray DiagramScene::documentItems(const QJsonDocument &doc)
+{
+    if(doc.isArray()){
+        return doc.array();
+    }
+    return doc.object()["items"].toArray();
+}
+/*!
+ * \brief find symbols used by item or its children
+ * \param item
+ * \param symbols
+ */
+void DiagramScene::collectSymbols(const QGraphicsItem *item, QMap<QString, DiagramSymbol::DefinitionPtr> &symbols) const
+{
+    if(item->type()==DiagramSymbol::Type){
+        const DiagramSymbol *symbol=qgraphicsitem_cast<const DiagramSymbol*>(item);
+        collectSymbol(symbol->symbolName(),symbol->definition(),symbols);
+    }
+    for(const QGraphicsItem *child:item->childItems()){
+        collectSymbols(child,symbols);
+    }
+}
+/*!
+ * \brief add a symbol and the symbols used in its definition
+ * \param name
+ * \param def
+ * \param symbols
+ */
+void DiagramScene::collectSymbol(const QString &name, const DiagramSymbol::DefinitionPtr &def, QMap<QString, DiagramSymbol::DefinitionPtr> &symbols) const
+{
+    if(!def || def->placeholder || symbols.contains(name)){
+        return;
+    }
+    symbols.insert(name,def);
+    QSet<QString> names;
+    collectSymbolNames(def->items,names);
+    for(const QString &inner:names){
+        collectSymbol(inner,m_symbols.value(inner),symbols);
+    }
+}
+/*!
+ * \brief create items from json without touching the items under construction
+ * \param array
+ * \return items, not added to any scene
+ */
+QList<QGraphicsItem *> DiagramScene::createItems(const QJsonArray &array)
+{
+    DiagramItem *keepItem=insertedItem;
+    DiagramDrawItem *keepDrawItem=insertedDrawItem;
+    DiagramPathItem *keepPathItem=insertedPathItem;
+    DiagramSplineItem *keepSplineItem=insertedSplineItem;
+    DiagramTextItem *keepTextItem=textItem;
+    QList<QGraphicsItem*> result;
+    for(int i=0;i<array.size();++i){
+        result<<getElementFromJSON(array[i].toObject());
     }
-    element->setBoundingBox(rect);
-    return element;
+    insertedItem=keepItem;
+    insertedDrawItem=keepDrawItem;
+    insertedPathItem=keepPathItem;
+    insertedSplineItem=keepSplineItem;
+    textItem=keepTextItem;
+    return result;
 }
 /*!
  * \brief filter selected child items
@@ -342,14 +756,8 @@ void DiagramScene::editorLostFocus(DiagramTextItem *item)
 void DiagramScene::wheelEvent(QGraphicsSceneWheelEvent *mouseEvent)
 {
     if(mouseEvent->modifiers()==Qt::ControlModifier){
-        int i =  mouseEvent->delta();
-        qreal factor;
-        if(i>=0){
-            factor = i/100.0;
-        }
-        else {
-            factor = -100.0/i; // negative Richtung ...
-        }
+        // 1.2 per notch, high resolution wheels send fractions of a notch
+        const qreal factor=qPow(1.2,mouseEvent->delta()/120.0);
         emit zoomPointer(factor,mouseEvent->scenePos());
         mouseEvent->setAccepted(true);
         return;
@@ -359,8 +767,12 @@ void DiagramScene::wheelEvent(QGraphicsSceneWheelEvent *mouseEvent)
 
 void DiagramScene::mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent)
 {
+    flushMouseMove();
+    flushDragPreview();
+    m_dragDeltaValid=false;
+    m_growOnly=true;
     if (mouseEvent->button() == Qt::RightButton){
-        if(selectedItems().isEmpty() && myMode==MoveItem){
+        if(selection().isEmpty() && myMode==MoveItem){
             // zoom area instead
             startPoint=mouseEvent->scenePos();
             myMode=ZoomSingle;
@@ -507,7 +919,7 @@ void DiagramScene::mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent)
         connect(textItem, &DiagramTextItem::receivedFocus,
                 this, &DiagramScene::editorReceivedFocus);
         connect(textItem, &DiagramTextItem::selectedChange,
-                this, &DiagramScene::itemSelected);
+                this, &DiagramScene::textItemSelected);
         addItem(textItem);
         textItem->setDefaultTextColor(myTextColor);
         textItem->setCorrectedPos(onGrid(mouseEvent->scenePos()));
@@ -626,9 +1038,9 @@ void DiagramScene::mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent)
         }
         else
         {
-            if(!selectedItems().isEmpty()){
+            if(!selection().isEmpty()){
                 // lösche doppelte Verweise (Child&selected)
-                myMoveItems=selectedItems();
+                myMoveItems=selection();
                 filterSelectedChildItems(myMoveItems);
                 // speichere Referenzpunkt
                 myDx=point.rx();
@@ -642,10 +1054,10 @@ void DiagramScene::mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent)
         break;
     }
     case CopyItem:
-        if (!selectedItems().empty()){
+        if (!selection().empty()){
             copiedItems.clear();
             // remove duplicated references (child&selected)
-            QList<QGraphicsItem*> myList=selectedItems();
+            QList<QGraphicsItem*> myList=selection();
             foreach(QGraphicsItem* item,myList){
                 if(item->parentItem())
                     if(item->parentItem()->isSelected()) {
@@ -736,7 +1148,36 @@ void DiagramScene::mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent)
     QGraphicsScene::mousePressEvent(mouseEvent);
 }
 
+/*!
+ * \brief coalesce mouse moves
+ * The first move of a frame is processed directly, later ones only
+ * replace the pending move which is processed when the frame is over.
+ * \param mouseEvent
+ */
 void DiagramScene::mouseMoveEvent(QGraphicsSceneMouseEvent *mouseEvent)
+{
+    if(m_moveTimer.isActive()){
+        copyMouseEvent(mouseEvent,&m_pendingMove);
+        m_movePending=true;
+        return;
+    }
+    processMouseMove(mouseEvent);
+    m_moveTimer.start();
+}
+/*!
+ * \brief process pending mouse move, if any
+ */
+void DiagramScene::flushMouseMove()
+{
+    if(!m_movePending){
+        return;
+    }
+    m_movePending=false;
+    processMouseMove(&m_pendingMove);
+    m_moveTimer.start();
+}
+
+void DiagramScene::processMouseMove(QGraphicsSceneMouseEvent *mouseEvent)
 {
     // move cursor
     myCursor.setPos(onGrid(mouseEvent->scenePos()));
@@ -754,6 +1195,19 @@ void DiagramScene::mouseMoveEvent(QGraphicsSceneMouseEvent *mouseEvent)
         }
         break;
     case MoveItem:
+        if(mouseEvent->buttons()==Qt::LeftButton && mouseGrabberItem()){
+            // dragged items only take grid positions, nothing changes as long as the snapped delta stays the same
+            QGraphicsItem *grabber=mouseGrabberItem();
+            auto *text=qgraphicsitem_cast<DiagramTextItem*>(grabber);
+            if(!text || text->textInteractionFlags()==Qt::NoTextInteraction){
+                QPointF delta=onGrid(mouseEvent->scenePos()-mouseEvent->buttonDownScenePos(Qt::LeftButton));
+                if(m_dragDeltaValid && delta==m_lastDragDelta){
+                    break;
+                }
+                m_lastDragDelta=delta;
+                m_dragDeltaValid=true;
+            }
+        }
         QGraphicsScene::mouseMoveEvent(mouseEvent);
         if(mouseEvent->buttons()==Qt::LeftButton){
             checkOnGrid();
@@ -764,14 +1218,7 @@ void DiagramScene::mouseMoveEvent(QGraphicsSceneMouseEvent *mouseEvent)
         QPointF point=onGrid(mouseEvent->scenePos());
         qreal dx=point.rx()-myDx;
         qreal dy=point.ry()-myDy;
-        foreach(QGraphicsItem* item,myMoveItems){
-            if(item->parentItem()!=0){
-                if(!item->parentItem()->isSelected()) item->moveBy(dx,dy);
-            }
-            else {
-                item->moveBy(dx,dy);
-            }
-        }
+        dragItemsBy(myMoveItems,dx,dy);
         myDx=point.rx();
         myDy=point.ry();
         break;
@@ -827,14 +1274,7 @@ void DiagramScene::mouseMoveEvent(QGraphicsSceneMouseEvent *mouseEvent)
             QPointF point=onGrid(mouseEvent->scenePos());
             qreal dx=point.rx()-myDx;
             qreal dy=point.ry()-myDy;
-            foreach(QGraphicsItem* item,copiedItems){
-                if(item->parentItem()!=0){
-                    if(!item->parentItem()->isSelected()) item->moveBy(dx,dy);
-                }
-                else {
-                    item->moveBy(dx,dy);
-                }
-            }
+            dragItemsBy(copiedItems,dx,dy);
             myDx=point.rx();
             myDy=point.ry();
         }
@@ -847,10 +1287,73 @@ void DiagramScene::mouseMoveEvent(QGraphicsSceneMouseEvent *mouseEvent)
     default:
         ;
     }
+    refreshEditedItems();
+}
+
+/*!
+ * \brief move items along with the mouse
+ * Children follow their parent, they are only moved themselves when the
+ * parent is not selected.
+ * \param items
+ * \param dx
+ * \param dy
+ */
+void DiagramScene::moveItemsBy(const QList<QGraphicsItem *> &items, qreal dx, qreal dy)
+{
+    for(QGraphicsItem* item:items){
+        if(item->parentItem()!=0){
+            if(!item->parentItem()->isSelected()) item->moveBy(dx,dy);
+        }
+        else {
+            item->moveBy(dx,dy);
+        }
+    }
+}
+/*!
+ * \brief move items during drag
+ * Large sets are not moved themselves but represented by a preview item,
+ * the accumulated move is applied by flushDragPreview().
+ * \param items
+ * \param dx
+ * \param dy
+ */
+void DiagramScene::dragItemsBy(const QList<QGraphicsItem *> &items, qreal dx, qreal dy)
+{
+    if(items.size()<DragPreviewItem::threshold){
+        moveItemsBy(items,dx,dy);
+        return;
+    }
+    if(!m_dragPreview){
+        m_dragPreview=new DragPreviewItem(items);
+        m_dragPreview->setZValue(maxZ);
+        addItem(m_dragPreview);
+    }
+    m_dragPreview->moveBy(dx,dy);
+}
+/*!
+ * \brief apply move accumulated in drag preview to the real items
+ */
+void DiagramScene::flushDragPreview()
+{
+    if(!m_dragPreview){
+        return;
+    }
+    DragPreviewItem *preview=m_dragPreview;
+    m_dragPreview=nullptr;
+    removeItem(preview);
+    preview->restore();
+    moveItemsBy(preview->items(),preview->x(),preview->y());
+    delete preview;
 }
 
 void DiagramScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *mouseEvent)
 {
+    flushMouseMove();
+    m_growOnly=false;
+    if(m_shrinkPending){
+        m_contentBoundsDirty=true;
+        m_shrinkPending=false;
+    }
     if (myMode == Zoom) {
         emit zoomRect(mouseEvent->scenePos(),startPoint);
         return;
@@ -866,9 +1369,9 @@ void DiagramScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *mouseEvent)
         m_rubberbandItem=nullptr;
         return;
     }
-    if(myMode== MoveItem && !selectedItems().isEmpty()){
+    if(myMode== MoveItem && !selection().isEmpty()){
         // update anchor points of textitems
-        for(QGraphicsItem* item:selectedItems()){
+        for(QGraphicsItem* item:selection()){
             if(item->type()==DiagramTextItem::Type){
                 auto *textItem=qgraphicsitem_cast<DiagramTextItem*>(item);
                 QPointF offset=textItem->getLastOffset();
@@ -884,6 +1387,7 @@ void DiagramScene::mouseReleaseEvent(QGraphicsSceneMouseEvent *mouseEvent)
 
 void DiagramScene::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *mouseEvent)
 {
+    flushMouseMove();
     switch (myMode){
     case InsertLine:
         //insertedPathItem->updateLast(onGrid(mouseEvent->scenePos()));
@@ -897,8 +1401,8 @@ void DiagramScene::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *mouseEvent)
         mouseEvent->accept();
         break;
     case MoveItem:
-        if(selectedItems().count()==1){
-            QGraphicsItem *item=selectedItems().first();
+        if(selection().count()==1){
+            QGraphicsItem *item=selection().first();
             if(item->type()==DiagramDrawItem::Type){
                 if(item->childItems().count()==1){
                     // already has text item
@@ -985,7 +1489,7 @@ void DiagramScene::mouseDoubleClickEvent(QGraphicsSceneMouseEvent *mouseEvent)
 
 void DiagramScene::checkOnGrid()
 {
-    foreach (QGraphicsItem *item, selectedItems()) {
+    foreach (QGraphicsItem *item, selection()) {
         if(item->parentItem()) continue; // don't change elements which are bound to other items, e.g. text for rectangle
         if(item->type()==DiagramTextItem::Type){
             DiagramTextItem *textItem=qgraphicsitem_cast<DiagramTextItem *>(item);
@@ -1029,7 +1533,7 @@ QGraphicsItem* DiagramScene::copy(QGraphicsItem* item)
         connect(textItem, &DiagramTextItem::receivedFocus,
                 this, &DiagramScene::editorReceivedFocus);
         connect(textItem, &DiagramTextItem::selectedChange,
-                this, &DiagramScene::itemSelected);
+                this, &DiagramScene::textItemSelected);
         return qgraphicsitem_cast<QGraphicsItem*>(textItem);
     }
         break;
@@ -1066,74 +1570,596 @@ QGraphicsItem* DiagramScene::copy(QGraphicsItem* item)
     }
 }
 
+/*!
+ * \brief delete all items but the cursor
+ * The index is dropped as a whole instead of removing item by item.
+ */
 void DiagramScene::clear()
 {
-    foreach(QGraphicsItem *item,items()){
-        if(item!=&myCursor)
-        {
-            removeItem(item);
-            delete item;
-        }
-    }
+    flushDragPreview();
+    beginBulkUpdate();
+    m_itemBounds.clear();
+    m_contentBounds=QRectF();
+    m_contentBoundsDirty=false;
+    m_shrinkPending=false;
+    m_pendingGrowth=QRectF();
+    emit contentChanged(QRectF());
+    // hidden layers stay hidden, only their items go
+    for(QList<QGraphicsItem*> &lst:m_hiddenItems){
+        qDeleteAll(lst);
+        lst.clear();
+    }
+    removeItem(&myCursor);
+    QGraphicsScene::clear();
+    addItem(&myCursor);
+    endBulkUpdate();
+    insertedItem = nullptr;
+    insertedDrawItem = nullptr;
+    insertedPathItem = nullptr;
+    insertedSplineItem = nullptr;
+    textItem = nullptr;
+    m_rubberbandItem = nullptr;
+    myMoveItems.clear();
+    copiedItems.clear();
+    m_selectionDirty=true;
 }
-
-void DiagramScene::copyToBuffer()
+/*!
+ * \brief suspend index maintenance for many insertions/removals
+ * The index is rebuilt once by endBulkUpdate(). Calls may be nested.
+ */
+void DiagramScene::beginBulkUpdate()
 {
-    // copy
-    qDeleteAll(bufferedItems);
-    bufferedItems.clear();
-    foreach(QGraphicsItem* item,selectedItems()){
-        QGraphicsItem *insItem=copy(item);
-        bufferedItems.append(insItem);
-        //check for children but not group
-        if(item->type()!=QGraphicsItemGroup::Type && item->childItems().count()>0){
-            foreach(QGraphicsItem* item_l1,item->childItems()){
-                QGraphicsItem* addedItem=copy(item_l1);
-                bufferedItems.append(addedItem);
-                addedItem->setParentItem(insItem);
-                addedItem->setPos(item_l1->pos());
-            }
-        }
+    if(m_bulkUpdate++==0){
+        m_bulkIndexMethod=itemIndexMethod();
+        setItemIndexMethod(NoIndex);
     }
 }
 
-void DiagramScene::pasteFromBuffer()
+void DiagramScene::endBulkUpdate()
 {
-    copiedItems.clear();
-    selectedItems().clear();
-    QRectF bnd=getTotalBoundary(bufferedItems);
-    QPointF center=onGrid(bnd.center());
-    myDx=myCursor.pos().x()-center.x();
-    myDy=myCursor.pos().y()-center.y();
-    foreach(QGraphicsItem* item,bufferedItems){
-        QGraphicsItem *newItem=copy(item);
-        addItem(newItem);
-        copiedItems.append(newItem);
-        newItem->moveBy(myDx,myDy);
+    if(--m_bulkUpdate==0){
+        setItemIndexMethod(m_bulkIndexMethod);
     }
-
-    myDx=myCursor.pos().x();
-    myDy=myCursor.pos().y();
-
-    myMode=CopyingItem;
 }
-
-void DiagramScene::setCursorVisible(bool vis)
+/*!
+ * \brief items whose bounding rect intersects rect
+ * \param rect
+ * \return unordered list
+ */
+QList<QGraphicsItem *> DiagramScene::itemsInRect(const QRectF &rect) const
 {
-    if(vis){
-        if(myCursor.scene()==0){
-            addItem(&myCursor);
+    return items(rect,Qt::IntersectsItemBoundingRect);
+}
+/*!
+ * \brief update bounds of items whose shape is edited interactively
+ * The items do not report changes of their shape themselves.
+ */
+void DiagramScene::refreshEditedItems()
+{
+    QList<QGraphicsItem*> lst;
+    lst<<mouseGrabberItem()<<insertedItem<<insertedDrawItem<<insertedPathItem<<insertedSplineItem;
+    for(QGraphicsItem *item:lst){
+        if(item && item->scene()==this){
+            trackBounds(item);
         }
     }
-    else
-    {
-        if(myCursor.scene()) removeItem(&myCursor);
-    }
 }
-
-void DiagramScene::deleteItem(QGraphicsItem *item)
+/*!
+ * \brief number of diagram items in the scene, including children
+ * Taken from the bounds bookkeeping, cheaper than items().size().
+ * \return
+ */
+int DiagramScene::itemCount() const
 {
-    if(item==insertedItem){
+    return m_itemBounds.size();
+}
+/*!
+ * \brief bounding rect of all diagram items
+ * Kept up to date while items are added, moved or removed. Only when an
+ * item on the border moves inwards or is removed, the union is rebuilt from
+ * the stored item rects on the next call.
+ * \return null rect for an empty scene
+ */
+QRectF DiagramScene::contentBounds() const
+{
+    if(m_contentBoundsDirty){
+        QRectF bounds;
+        for(auto it=m_itemBounds.constBegin();it!=m_itemBounds.constEnd();++it){
+            bounds|=it.value();
+        }
+        m_contentBounds=bounds;
+        m_contentBoundsDirty=false;
+    }
+    return m_contentBounds;
+}
+/*!
+ * \brief set scene rect to content plus margin
+ * While editing the scene rect only grows, so the view does not jump.
+ * Use this after loading a document.
+ */
+void DiagramScene::fitSceneRect()
+{
+    m_sceneRectTimer.stop();
+    m_pendingGrowth=QRectF();
+    const qreal m=sceneRectMargin;
+    QRectF rect=defaultSceneRect;
+    const QRectF bounds=contentBounds();
+    if(!bounds.isNull()){
+        rect|=bounds.adjusted(-m,-m,m,m);
+    }
+    setSceneRect(rect);
+}
+/*!
+ * \brief item whose stored rect covers item
+ * Groups do not report their moves, so their children are tracked themselves.
+ * \param item
+ * \return topmost ancestor below a group
+ */
+static QGraphicsItem *boundsOwner(QGraphicsItem *item)
+{
+    while(item->parentItem() && item->parentItem()->type()!=QGraphicsItemGroup::Type){
+        item=item->parentItem();
+    }
+    return item;
+}
+/*!
+ * \brief store new scene rect of item and extend content bounds
+ * Children are counted with a null rect, their area is part of the rect of
+ * the owning item. So only the owner needs to report scene position changes.
+ * \param item
+ */
+void DiagramScene::trackBounds(QGraphicsItem *item)
+{
+    QGraphicsItem *owner=boundsOwner(item);
+    if(owner!=item){
+        auto it=m_itemBounds.find(item);
+        if(it==m_itemBounds.end()){
+            m_itemBounds.insert(item,QRectF());
+        }else if(!it.value().isNull()){
+            // was tracked itself before it got a parent
+            item->setFlag(QGraphicsItem::ItemSendsScenePositionChanges,false);
+            if(touchesContentEdge(it.value())){
+                m_contentBoundsDirty=true;
+            }
+            it.value()=QRectF();
+        }
+        if(owner->scene()!=this){
+            return;
+        }
+        item=owner;
+    }
+    const QRectF rect=item->sceneBoundingRect()|item->mapRectToScene(item->childrenBoundingRect());
+    if(!(item->flags() & QGraphicsItem::ItemSendsScenePositionChanges)){
+        item->setFlag(QGraphicsItem::ItemSendsGeometryChanges);
+        item->setFlag(QGraphicsItem::ItemSendsScenePositionChanges);
+    }
+    auto it=m_itemBounds.find(item);
+    if(it==m_itemBounds.end()){
+        m_itemBounds.insert(item,rect);
+        emit contentChanged(rect);
+    }else{
+        if(it.value()==rect){
+            return;
+        }
+        emit contentChanged(it.value()|rect);
+        if(!m_contentBoundsDirty && touchesContentEdge(it.value()) && !rect.contains(it.value())){
+            // an item dragged along the edge would rebuild the bounds on every move
+            if(m_growOnly){
+                m_shrinkPending=true;
+            }else{
+                m_contentBoundsDirty=true;
+            }
+        }
+        it.value()=rect;
+    }
+    if(!m_contentBoundsDirty){
+        m_contentBounds|=rect;
+    }
+    if(!rect.isNull() && !sceneRect().contains(rect)){
+        m_pendingGrowth|=rect;
+        m_sceneRectTimer.start();
+    }
+}
+
+void DiagramScene::untrackBounds(QGraphicsItem *item)
+{
+    auto it=m_itemBounds.find(item);
+    if(it==m_itemBounds.end()){
+        return;
+    }
+    QRectF rect=it.value();
+    m_itemBounds.erase(it);
+    if(rect.isNull() && item->parentItem()){
+        // a child leaves, the rect of its owner may shrink
+        rect=m_itemBounds.value(boundsOwner(item));
+    }
+    if(!rect.isNull()){
+        emit contentChanged(rect);
+    }
+    if(!rect.isNull() && touchesContentEdge(rect)){
+        m_contentBoundsDirty=true;
+    }
+}
+/*!
+ * \brief check whether rect defines part of the content bounds
+ * \param rect
+ * \return
+ */
+bool DiagramScene::touchesContentEdge(const QRectF &rect) const
+{
+    return rect.left()<=m_contentBounds.left() || rect.top()<=m_contentBounds.top()
+            || rect.right()>=m_contentBounds.right() || rect.bottom()>=m_contentBounds.bottom();
+}
+/*!
+ * \brief extend scene rect by the content added since the last call
+ * Runs once per event loop pass, so a drag outside does not resize the scrollbars per item.
+ */
+void DiagramScene::growSceneRect()
+{
+    if(m_pendingGrowth.isNull()){
+        return;
+    }
+    const qreal m=sceneRectMargin;
+    setSceneRect(sceneRect()|m_pendingGrowth.adjusted(-m,-m,m,m));
+    m_pendingGrowth=QRectF();
+}
+/*!
+ * \brief dispatch change notifications of the diagram items
+ * Called from itemChange() of the items, keeps the content bounds of the
+ * scene up to date.
+ * \param item
+ * \param change
+ */
+void DiagramScene::itemChanged(QGraphicsItem *item, QGraphicsItem::GraphicsItemChange change)
+{
+    switch (change) {
+    case QGraphicsItem::ItemSceneChange:
+    case QGraphicsItem::ItemSceneHasChanged:
+    case QGraphicsItem::ItemScenePositionHasChanged:
+    case QGraphicsItem::ItemTransformHasChanged:
+    case QGraphicsItem::ItemParentHasChanged:
+        break;
+    default:
+        return;
+    }
+    // on ItemSceneChange scene() is still the scene the item leaves
+    auto *scene=qobject_cast<DiagramScene*>(item->scene());
+    if(!scene){
+        return;
+    }
+    if(change==QGraphicsItem::ItemSceneChange){
+        scene->untrackBounds(item);
+    }else{
+        if(change==QGraphicsItem::ItemSceneHasChanged){
+            scene->assignLayer(item);
+        }
+        scene->trackBounds(item);
+    }
+}
+
+/*!
+ * \brief names of all layers
+ * The default layer is the empty string and always first.
+ * \return
+ */
+QStringList DiagramScene::layers() const
+{
+    return m_layers;
+}
+
+void DiagramScene::addLayer(const QString &name)
+{
+    if(m_layers.contains(name)){
+        return;
+    }
+    m_layers<<name;
+    emit layersChanged();
+}
+/*!
+ * \brief remove layer, its items go to the default layer
+ * \param name
+ */
+void DiagramScene::removeLayer(const QString &name)
+{
+    if(name.isEmpty() || !m_layers.contains(name)){
+        return;
+    }
+    setLayerVisible(name,true);
+    setLayerLocked(name,false);
+    for(QGraphicsItem *item:layerItems(name)){
+        item->setData(LayerData,QString());
+    }
+    m_layers.removeOne(name);
+    if(m_currentLayer==name){
+        m_currentLayer.clear();
+    }
+    emit layersChanged();
+}
+/*!
+ * \brief back to only the default layer, for a new document
+ * Call after clear().
+ */
+void DiagramScene::resetLayers()
+{
+    for(const QList<QGraphicsItem*> &lst:m_hiddenItems){
+        qDeleteAll(lst);
+    }
+    m_hiddenItems.clear();
+    m_lockedLayers.clear();
+    m_layers.clear();
+    m_layers<<QString();
+    m_currentLayer.clear();
+    emit layersChanged();
+}
+/*!
+ * \brief set layer for new items
+ * The current layer is made visible and unlocked.
+ * \param name
+ */
+void DiagramScene::setCurrentLayer(const QString &name)
+{
+    addLayer(name);
+    setLayerVisible(name,true);
+    setLayerLocked(name,false);
+    m_currentLayer=name;
+    emit layersChanged();
+}
+
+QString DiagramScene::currentLayer() const
+{
+    return m_currentLayer;
+}
+/*!
+ * \brief show/hide layer
+ * Items of hidden layers are taken out of the scene, so they are neither
+ * indexed nor painted. They are still saved.
+ * The default layer cannot be hidden.
+ * \param name
+ * \param visible
+ */
+void DiagramScene::setLayerVisible(const QString &name, bool visible)
+{
+    if(visible==isLayerVisible(name) || !m_layers.contains(name)){
+        return;
+    }
+    if(!visible && name.isEmpty()){
+        return;
+    }
+    flushDragPreview();
+    beginBulkUpdate();
+    if(visible){
+        const QList<QGraphicsItem*> lst=m_hiddenItems.take(name);
+        for(QGraphicsItem *item:lst){
+            addItem(item);
+        }
+    }else{
+        if(m_currentLayer==name){
+            m_currentLayer.clear();
+        }
+        const QList<QGraphicsItem*> lst=layerItems(name);
+        for(QGraphicsItem *item:lst){
+            removeItem(item);
+        }
+        m_hiddenItems.insert(name,lst);
+    }
+    endBulkUpdate();
+    m_selectionDirty=true;
+    emit layersChanged();
+}
+
+bool DiagramScene::isLayerVisible(const QString &name) const
+{
+    return !m_hiddenItems.contains(name);
+}
+/*!
+ * \brief lock/unlock layer
+ * Items of locked layers cannot be selected or moved and take no mouse or
+ * hover events. The default layer cannot be locked.
+ * \param name
+ * \param locked
+ */
+void DiagramScene::setLayerLocked(const QString &name, bool locked)
+{
+    if(locked==isLayerLocked(name) || !m_layers.contains(name)){
+        return;
+    }
+    if(locked && name.isEmpty()){
+        return;
+    }
+    if(locked){
+        m_lockedLayers.insert(name);
+        if(m_currentLayer==name){
+            m_currentLayer.clear();
+        }
+    }else{
+        m_lockedLayers.remove(name);
+    }
+    for(QGraphicsItem *item:layerItems(name)){
+        lockItem(item,locked);
+    }
+    for(QGraphicsItem *item:m_hiddenItems.value(name)){
+        lockItem(item,locked);
+    }
+    emit layersChanged();
+}
+
+bool DiagramScene::isLayerLocked(const QString &name) const
+{
+    return m_lockedLayers.contains(name);
+}
+/*!
+ * \brief assign top level items to layer
+ * \param items
+ * \param name
+ */
+void DiagramScene::moveToLayer(const QList<QGraphicsItem *> &items, const QString &name)
+{
+    addLayer(name);
+    const QList<QGraphicsItem*> lst=items;
+    for(QGraphicsItem *item:lst){
+        if(item->parentItem()){
+            continue;
+        }
+        lockItem(item,false);
+        item->setData(LayerData,name);
+        if(m_lockedLayers.contains(name)){
+            lockItem(item,true);
+        }
+        if(m_hiddenItems.contains(name)){
+            removeItem(item);
+            m_hiddenItems[name]<<item;
+        }
+    }
+}
+
+QString DiagramScene::layerOf(const QGraphicsItem *item)
+{
+    return item->data(LayerData).toString();
+}
+/*!
+ * \brief top level items of layer in the scene
+ * Items without layer (e.g. groups) count as default layer.
+ * \param name
+ * \return
+ */
+QList<QGraphicsItem *> DiagramScene::layerItems(const QString &name) const
+{
+    QList<QGraphicsItem*> result;
+    for(QGraphicsItem *item:items()){
+        if(!item->parentItem() && layerOf(item)==name){
+            result<<item;
+        }
+    }
+    return result;
+}
+/*!
+ * \brief make item and children (not) take part in interaction
+ * The previous state is kept in the item data for unlocking.
+ * \param item
+ * \param lock
+ */
+void DiagramScene::lockItem(QGraphicsItem *item, bool lock)
+{
+    const QGraphicsItem::GraphicsItemFlags mask=QGraphicsItem::ItemIsSelectable|QGraphicsItem::ItemIsMovable
+            |QGraphicsItem::ItemIsFocusable;
+    const QVariant saved=item->data(LockData);
+    if(lock && !saved.isValid()){
+        QVariantList state;
+        state<<int(item->flags()&mask)<<int(item->acceptedMouseButtons())<<item->acceptHoverEvents();
+        item->setData(LockData,state);
+        item->setSelected(false);
+        item->setFlags(item->flags()&~mask);
+        item->setAcceptedMouseButtons(Qt::NoButton);
+        item->setAcceptHoverEvents(false);
+    }else if(!lock && saved.isValid()){
+        const QVariantList state=saved.toList();
+        item->setFlags((item->flags()&~mask)|QGraphicsItem::GraphicsItemFlags(QFlag(state.at(0).toInt())));
+        item->setAcceptedMouseButtons(Qt::MouseButtons(QFlag(state.at(1).toInt())));
+        item->setAcceptHoverEvents(state.at(2).toBool());
+        item->setData(LockData,QVariant());
+    }
+    for(QGraphicsItem *child:item->childItems()){
+        lockItem(child,lock);
+    }
+}
+/*!
+ * \brief put new top level item on the current layer
+ * Loaded items bring their layer along. Items of locked layers are locked.
+ * \param item
+ */
+void DiagramScene::assignLayer(QGraphicsItem *item)
+{
+    if(item->parentItem()){
+        return;
+    }
+    if(!item->data(LayerData).isValid()){
+        item->setData(LayerData,m_currentLayer);
+    }
+    const QString name=layerOf(item);
+    if(!m_layers.contains(name)){
+        m_layers<<name;
+        emit layersChanged();
+    }
+    if(m_lockedLayers.contains(name)){
+        lockItem(item,true);
+    }
+}
+
+void DiagramScene::itemGeometryChanged(QGraphicsItem *item)
+{
+    auto *scene=qobject_cast<DiagramScene*>(item->scene());
+    if(scene){
+        scene->trackBounds(item);
+        // the content may change without moving the bounds
+        emit scene->contentChanged(item->sceneBoundingRect());
+    }
+}
+
+void DiagramScene::itemDestroyed(QGraphicsItem *item)
+{
+    auto *scene=qobject_cast<DiagramScene*>(item->scene());
+    if(scene){
+        scene->untrackBounds(item);
+    }
+}
+
+void DiagramScene::copyToBuffer()
+{
+    // copy
+    qDeleteAll(bufferedItems);
+    bufferedItems.clear();
+    foreach(QGraphicsItem* item,selection()){
+        QGraphicsItem *insItem=copy(item);
+        bufferedItems.append(insItem);
+        //check for children but not group
+        if(item->type()!=QGraphicsItemGroup::Type && item->childItems().count()>0){
+            foreach(QGraphicsItem* item_l1,item->childItems()){
+                QGraphicsItem* addedItem=copy(item_l1);
+                bufferedItems.append(addedItem);
+                addedItem->setParentItem(insItem);
+                addedItem->setPos(item_l1->pos());
+            }
+        }
+    }
+}
+
+void DiagramScene::pasteFromBuffer()
+{
+    copiedItems.clear();
+    clearSelection();
+    QRectF bnd=getTotalBoundary(bufferedItems);
+    QPointF center=onGrid(bnd.center());
+    myDx=myCursor.pos().x()-center.x();
+    myDy=myCursor.pos().y()-center.y();
+    foreach(QGraphicsItem* item,bufferedItems){
+        QGraphicsItem *newItem=copy(item);
+        addItem(newItem);
+        copiedItems.append(newItem);
+        newItem->moveBy(myDx,myDy);
+    }
+
+    myDx=myCursor.pos().x();
+    myDy=myCursor.pos().y();
+
+    myMode=CopyingItem;
+}
+
+void DiagramScene::setCursorVisible(bool vis)
+{
+    if(vis){
+        if(myCursor.scene()==0){
+            addItem(&myCursor);
+        }
+    }
+    else
+    {
+        if(myCursor.scene()) removeItem(&myCursor);
+    }
+}
+
+void DiagramScene::deleteItem(QGraphicsItem *item)
+{
+    if(item==insertedItem){
         insertedItem=nullptr;
     }
     if(item==insertedDrawItem){
@@ -1159,10 +2185,86 @@ void DiagramScene::insertElementDirectly(const QString element)
  * active items are selected items or insertItem
  * \return
  */
+/*!
+ * \brief selected items without walking the scene
+ * The list is kept until the selection changes. Take a copy before
+ * changing the selection while iterating.
+ * \return
+ */
+const QList<QGraphicsItem *> &DiagramScene::selection() const
+{
+    if(m_selectionDirty){
+        m_selection=selectedItems();
+        m_selectionDirty=false;
+    }
+    return m_selection;
+}
+
+/*!
+ * \brief select/deselect items with a single notification
+ * \param items
+ * \param select
+ */
+void DiagramScene::selectItems(const QList<QGraphicsItem *> &items, bool select)
+{
+    {
+        const QSignalBlocker blocker(this);
+        ++m_bulkSelection;
+        for(QGraphicsItem *item:items){
+            item->setSelected(select);
+        }
+        --m_bulkSelection;
+    }
+    finishBulkSelection();
+}
+
+void DiagramScene::selectAllItems()
+{
+    selectItems(items());
+}
+/*!
+ * \brief aggregated notification after bulk selection
+ * Text controls are only updated when a single text item is selected.
+ */
+void DiagramScene::finishBulkSelection()
+{
+    m_selectionDirty=true;
+    emit selectionChanged();
+    const QList<QGraphicsItem*> &lst=selection();
+    if(lst.size()==1 && lst.first()->type()==DiagramTextItem::Type){
+        emit itemSelected(lst.first());
+    }
+}
+/*!
+ * \brief relay selection change of text items
+ * Changes of many text items (e.g. rubberband) are reported once, the
+ * notification is queued until control returns to the event loop.
+ * \param item
+ */
+void DiagramScene::textItemSelected(QGraphicsItem *item)
+{
+    if(m_bulkSelection>0){
+        return;
+    }
+    m_selectedTextItem=qgraphicsitem_cast<DiagramTextItem*>(item);
+    if(!m_textSelectionQueued){
+        m_textSelectionQueued=true;
+        QTimer::singleShot(0,this,&DiagramScene::emitTextItemSelected);
+    }
+}
+
+void DiagramScene::emitTextItemSelected()
+{
+    m_textSelectionQueued=false;
+    if(m_selectedTextItem){
+        emit itemSelected(m_selectedTextItem);
+    }
+}
+
 QList<QGraphicsItem *> DiagramScene::activeItems() const
 {
-    if(!selectedItems().isEmpty()){
-        return selectedItems();
+    if(!selection().isEmpty()){
+        return selection();
     }
     if(!myMoveItems.isEmpty()){
         return myMoveItems;
@@ -1180,8 +2282,9 @@ QList<QGraphicsItem *> DiagramScene::activeItems() const
  */
 void DiagramScene::duplicateItems()
 {
-    if(!selectedItems().isEmpty()){
-        for(auto *item:selectedItems()){
+    if(!selection().isEmpty()){
+        const QList<QGraphicsItem*> lst=selection();
+        for(auto *item:lst){
             //TODO !
             // copy item
             item->setSelected(false);
@@ -1212,6 +2315,180 @@ void DiagramScene::setMaxZ(qreal z)
         maxZ=z+0.1;
     }
 }
+/*!
+ * \brief put items on top of all others, keeping their relative order
+ * \param lst
+ */
+void DiagramScene::bringToFront(QList<QGraphicsItem *> lst)
+{
+    prepareZOrder(lst);
+    for(QGraphicsItem *item:lst){
+        item->setZValue(maxZ);
+        maxZ+=0.1;
+    }
+    checkZOrder(0.1);
+}
+/*!
+ * \brief put items below all others, keeping their relative order
+ * \param lst
+ */
+void DiagramScene::sendToBack(QList<QGraphicsItem *> lst)
+{
+    prepareZOrder(lst);
+    for(int i=lst.size()-1;i>=0;--i){
+        minZ-=0.1;
+        lst[i]->setZValue(minZ);
+    }
+    checkZOrder(0.1);
+}
+/*!
+ * \brief move items above the next overlapping item
+ * Only the items in the area of the moved ones are queried from the index,
+ * the items are placed between the next higher item and the one after.
+ * \param lst
+ */
+void DiagramScene::bringUp(QList<QGraphicsItem *> lst)
+{
+    prepareZOrder(lst);
+    if(lst.isEmpty()) return;
+    const qreal top=lst.last()->zValue();
+    QRectF region;
+    QSet<QGraphicsItem*> moving;
+    for(QGraphicsItem *item:lst){
+        region|=item->sceneBoundingRect();
+        moving.insert(item);
+    }
+    bool found=false;
+    bool hasAbove=false;
+    qreal next=0;
+    qreal above=0;
+    for(QGraphicsItem *item:itemsInRect(region)){
+        if(item->parentItem() || !isZOrdered(item) || moving.contains(item)) continue;
+        const qreal z=item->zValue();
+        if(z<=top) continue;
+        if(!found || z<next){
+            if(found){
+                above=next;
+                hasAbove=true;
+            }
+            next=z;
+            found=true;
+        }else if(z>next && (!hasAbove || z<above)){
+            above=z;
+            hasAbove=true;
+        }
+    }
+    if(!found) return;
+    if(!hasAbove){
+        above=next+0.2;
+        setMaxZ(above);
+    }
+    const qreal step=(above-next)/(lst.size()+1);
+    for(int i=0;i<lst.size();++i){
+        lst[i]->setZValue(next+step*(i+1));
+    }
+    checkZOrder(step);
+}
+/*!
+ * \brief move items below the next overlapping item
+ * \param lst
+ */
+void DiagramScene::sendDown(QList<QGraphicsItem *> lst)
+{
+    prepareZOrder(lst);
+    if(lst.isEmpty()) return;
+    const qreal bottom=lst.first()->zValue();
+    QRectF region;
+    QSet<QGraphicsItem*> moving;
+    for(QGraphicsItem *item:lst){
+        region|=item->sceneBoundingRect();
+        moving.insert(item);
+    }
+    bool found=false;
+    bool hasBelow=false;
+    qreal next=0;
+    qreal below=0;
+    for(QGraphicsItem *item:itemsInRect(region)){
+        if(item->parentItem() || !isZOrdered(item) || moving.contains(item)) continue;
+        const qreal z=item->zValue();
+        if(z>=bottom) continue;
+        if(!found || z>next){
+            if(found){
+                below=next;
+                hasBelow=true;
+            }
+            next=z;
+            found=true;
+        }else if(z<next && (!hasBelow || z>below)){
+            below=z;
+            hasBelow=true;
+        }
+    }
+    if(!found) return;
+    if(!hasBelow){
+        below=next-0.2;
+        minZ=qMin(minZ,below);
+    }
+    const qreal step=(next-below)/(lst.size()+1);
+    for(int i=0;i<lst.size();++i){
+        lst[i]->setZValue(below+step*(i+1));
+    }
+    checkZOrder(step);
+}
+/*!
+ * \brief items which take part in the z order of the diagram
+ * \param item
+ * \return
+ */
+bool DiagramScene::isZOrdered(const QGraphicsItem *item) const
+{
+    return item!=&myCursor && item!=m_rubberbandItem && item->type()!=DragPreviewItem::Type;
+}
+/*!
+ * \brief reduce to top level items sorted by ascending z
+ * \param lst
+ */
+void DiagramScene::prepareZOrder(QList<QGraphicsItem *> &lst) const
+{
+    for(int i=lst.size()-1;i>=0;--i){
+        if(lst.at(i)->parentItem() || !isZOrdered(lst.at(i))){
+            lst.removeAt(i);
+        }
+    }
+    std::stable_sort(lst.begin(),lst.end(),[](const QGraphicsItem *a,const QGraphicsItem *b){
+        return a->zValue()<b->zValue();
+    });
+}
+/*!
+ * \brief schedule renormalization if z values run out of precision
+ * \param gap smallest gap created by the last operation
+ */
+void DiagramScene::checkZOrder(qreal gap)
+{
+    if(gap<1e-6 || maxZ>1e6 || minZ<-1e6){
+        m_zOrderTimer.start();
+    }
+}
+/*!
+ * \brief reassign evenly spaced z values, keeping the stacking order
+ * Postponed while items are inserted or dragged.
+ */
+void DiagramScene::renormalizeZ()
+{
+    if(myMode!=MoveItem || mouseGrabberItem() || m_dragPreview){
+        m_zOrderTimer.start();
+        return;
+    }
+    qreal z=0;
+    const QList<QGraphicsItem*> lst=items(Qt::AscendingOrder);
+    for(QGraphicsItem *item:lst){
+        if(item->parentItem() || !isZOrdered(item)) continue;
+        item->setZValue(z);
+        z+=0.1;
+    }
+    minZ=0;
+    maxZ=z;
+}
 /*!
  * \brief save current scene content as json into m_snapshots
  */
@@ -1224,6 +2501,14 @@ void DiagramScene::takeSnapshot()
         if(m_snapshots.at(m_undoPos)==doc)
             return;
     }
+    // edits of color, pen or font do not move any bounds, they apply to the selection
+    QRectF edited;
+    for(const QGraphicsItem *item:selection()){
+        edited|=item->sceneBoundingRect()|item->mapRectToScene(item->childrenBoundingRect());
+    }
+    if(!edited.isNull()){
+        emit contentChanged(edited);
+    }
     if(m_snapshots.size()>m_undoPos+1){
         m_snapshots.insert(m_undoPos+1,doc);
         ++m_undoPos;
@@ -1233,6 +2518,7 @@ void DiagramScene::takeSnapshot()
         m_snapshots<<doc;
         ++m_undoPos;
     }
+    emit snapshotTaken(doc);
 }
 /*!
  * \brief restore snapshot
@@ -1246,11 +2532,13 @@ void DiagramScene::restoreSnapshot(int pos)
             --m_undoPos;
             clear();
             read_in_json(m_snapshots.at(m_undoPos));
+            emit snapshotTaken(m_snapshots.at(m_undoPos));
         }
     }else{
         clear();
         read_in_json(m_snapshots.at(pos));
         m_undoPos=pos;
+        emit snapshotTaken(m_snapshots.at(pos));
     }
 }
 /*!
@@ -1306,6 +2594,7 @@ void DiagramScene::editorReceivedFocus(DiagramTextItem *item)
  */
 void DiagramScene::abort(bool keepSelection)
 {
+    flushDragPreview();
     switch(myMode){
     case CopyingItem:
         foreach(QGraphicsItem* item,copiedItems){
@@ -1348,6 +2637,7 @@ void DiagramScene::abort(bool keepSelection)
     insertedPathItem=nullptr;
     insertedSplineItem=nullptr;
     copiedItems.clear();
+    m_movePending=false;
 
     if(!keepSelection) clearSelection();
     if(!keepSelection && myMode==MoveItem){
@@ -1355,25 +2645,210 @@ void DiagramScene::abort(bool keepSelection)
     }
 }
 
+/*!
+ * \brief save document
+ * The document starts with a header on its own line, so it can be read
+ * without parsing the items, see readHeader().
+ * \param file
+ * \param selectedItemsOnly
+ * \return
+ */
 bool DiagramScene::save_json(QFile *file, bool selectedItemsOnly)
 {
     QJsonDocument doc=create_json_save(selectedItemsOnly);
-    file->write(doc.toJson());
+    if(m_embedElements){
+        doc=embedElementDefinitions(doc);
+    }
+    const QJsonObject header=documentHeader(doc,selectedItemsOnly);
+    QJsonObject root;
+    if(doc.isArray()){
+        root["items"]=doc.array();
+    }else{
+        root=doc.object();
+    }
+    // QJsonDocument sorts keys, the header line is put first by hand
+    const QByteArray body=QJsonDocument(root).toJson();
+    file->write("{\n\"header\": ");
+    file->write(QJsonDocument(header).toJson(QJsonDocument::Compact));
+    file->write(",\n");
+    file->write(body.mid(body.indexOf('\n')+1));
     return true;
 }
+/*!
+ * \brief metadata of document for previews
+ * \param doc
+ * \param selectedItemsOnly
+ * \return item count, bounds, used element files and preview image
+ */
+QJsonObject DiagramScene::documentHeader(const QJsonDocument &doc, bool selectedItemsOnly)
+{
+    const QJsonArray items=documentItems(doc);
+    QJsonObject header;
+    header["version"]=1;
+    header["items"]=items.size();
+    QRectF bounds;
+    if(selectedItemsOnly){
+        for(const QGraphicsItem *item:selection()){
+            bounds|=item->sceneBoundingRect();
+        }
+    }else{
+        bounds=contentBounds();
+    }
+    header["bounds"]=QJsonArray({bounds.x(),bounds.y(),bounds.width(),bounds.height()});
+    QSet<QString> files;
+    collectElementFiles(items,files);
+    const QJsonObject symbols=doc.object()["symbols"].toObject();
+    for(const QJsonValue &symbol:symbols){
+        collectElementFiles(symbol.toObject()["items"].toArray(),files);
+    }
+    QStringList lst=files.values();
+    lst.sort();
+    header["elementFiles"]=QJsonArray::fromStringList(lst);
+    // user elements are saved as selection, their preview is used as thumbnail
+    const QImage image=selectedItemsOnly ? renderPreview(items,previewSize) : renderPreview(previewSize);
+    if(!image.isNull()){
+        QByteArray png;
+        QBuffer buffer(&png);
+        buffer.open(QIODevice::WriteOnly);
+        image.save(&buffer,"PNG");
+        header["preview"]=QString::fromLatin1(png.toBase64());
+    }
+    return header;
+}
+/*!
+ * \brief find element files in items and their children
+ * \param items
+ * \param files
+ */
+void DiagramScene::collectElementFiles(const QJsonArray &items, QSet<QString> &files)
+{
+    for(const QJsonValue &value:items){
+        const QJsonObject json=value.toObject();
+        if(json["type"].toInt()==DiagramElement::Type){
+            files.insert(json["filename"].toString());
+        }
+        collectElementFiles(json["children"].toArray(),files);
+    }
+}
+/*!
+ * \brief render content without grid, cursor and selection
+ * The items are painted one by one as if unselected. Neither selection nor
+ * cursor are changed for it, so saving does not update views or overview.
+ * \param size maximum width and height
+ * \return
+ */
+QImage DiagramScene::renderPreview(int size)
+{
+    QRectF rect=contentBounds();
+    if(rect.isEmpty()){
+        return QImage();
+    }
+    rect.adjust(-1,-1,1,1);
+    const qreal scale=qMin(1.,size/qMax(rect.width(),rect.height()));
+    QImage image(qCeil(rect.width()*scale),qCeil(rect.height()*scale),QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    const QTransform toImage=QTransform::fromScale(scale,scale).translate(-rect.x(),-rect.y());
+    QStyleOptionGraphicsItem option;
+    for(QGraphicsItem *item:items(rect,Qt::IntersectsItemBoundingRect,Qt::AscendingOrder)){
+        if(item==&myCursor || !item->isVisible()){
+            continue;
+        }
+        option.state=item->isEnabled() ? QStyle::State_Enabled : QStyle::State_None;
+        option.exposedRect=item->boundingRect();
+        painter.setTransform(item->sceneTransform()*toImage);
+        painter.setOpacity(item->effectiveOpacity());
+        item->paint(&painter,&option,nullptr);
+    }
+    painter.end();
+    return image;
+}
+/*!
+ * \brief render items of a document, e.g. the selection saved as user element
+ * The items are built in a scene of their own.
+ * \param items
+ * \param size maximum width and height
+ * \return
+ */
+QImage DiagramScene::renderPreview(const QJsonArray &items, int size)
+{
+    QGraphicsScene recorder;
+    QRectF rect;
+    for(QGraphicsItem *item:createItems(items)){
+        recorder.addItem(item);
+        rect|=item->sceneBoundingRect();
+    }
+    return previewImage(&recorder,rect,size);
+}
+/*!
+ * \brief read header of document without reading its items
+ * Only the first two lines are read.
+ * \param fileName
+ * \return header, empty for documents without one
+ */
+QJsonObject DiagramScene::readHeader(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly)){
+        return QJsonObject();
+    }
+    if(file.readLine(16).trimmed()!="{"){
+        return QJsonObject();
+    }
+    QByteArray line=file.readLine(maxHeaderSize).trimmed();
+    if(!line.startsWith("\"header\"")){
+        return QJsonObject();
+    }
+    if(line.endsWith(',')){
+        line.chop(1);
+    }
+    return QJsonDocument::fromJson("{"+line+"}").object()["header"].toObject();
+}
+/*!
+ * \brief preview image stored in header
+ * \param header
+ * \return
+ */
+QImage DiagramScene::headerPreview(const QJsonObject &header)
+{
+    return QImage::fromData(QByteArray::fromBase64(header["preview"].toString().toLatin1()),"PNG");
+}
 /*!
  * \brief create json save data
  * \return
  */
 QJsonDocument DiagramScene::create_json_save(bool selectedItemsOnly)
 {
+    flushDragPreview();
     QJsonArray array;
-    QList<QGraphicsItem*> lst=selectedItemsOnly ? selectedItems() : items();
+    QList<QGraphicsItem*> lst=selectedItemsOnly ? selection() : items();
+    if(!selectedItemsOnly){
+        for(const QList<QGraphicsItem*> &hidden:m_hiddenItems){
+            lst<<hidden;
+        }
+    }
+    QMap<QString,DiagramSymbol::DefinitionPtr> symbols;
     foreach(QGraphicsItem* item, lst){
         if(item->parentItem()) continue;
         addElementToJSON(item,array);
-    }
-    QJsonDocument doc(array);
+        collectSymbols(item,symbols);
+    }
+    if(symbols.isEmpty()){
+        QJsonDocument doc(array);
+        return doc;
+    }
+    // each symbol definition is stored once
+    QJsonObject defs;
+    for(auto it=symbols.constBegin();it!=symbols.constEnd();++it){
+        QJsonObject def;
+        def["items"]=it.value()->items;
+        defs[it.key()]=def;
+    }
+    QJsonObject root;
+    root["symbols"]=defs;
+    root["items"]=array;
+    QJsonDocument doc(root);
     return doc;
 }
 
@@ -1391,11 +2866,23 @@ bool DiagramScene::load_json(QFile *file)
  */
 void DiagramScene::read_in_json(QJsonDocument doc)
 {
-    QJsonArray array=doc.array();
+    DiagramElement::beginEmbeddedDefinitions(doc.object()["elements"].toObject());
+    readSymbols(doc);
+    QJsonArray array=documentItems(doc);
+    beginBulkUpdate();
     for(int i=0;i<array.size();++i){
         QJsonObject json=array[i].toObject();
         QGraphicsItem *item=getElementFromJSON(json);
-        addItem(item);
+        if(!item->data(LayerData).isValid()){
+            item->setData(LayerData,QString());
+        }
+        if(m_hiddenItems.contains(layerOf(item))){
+            m_hiddenItems[layerOf(item)]<<item;
+        }else{
+            addItem(item);
+        }
+        setMaxZ(item->zValue());
+        minZ=qMin(minZ,item->zValue());
         if(item->type()==DiagramItem::Type){
             QRectF rect;
             for(const auto* it:item->childItems()){
@@ -1404,6 +2891,8 @@ void DiagramScene::read_in_json(QJsonDocument doc)
             qgraphicsitem_cast<DiagramItem*>(item)->setBoundingBox(rect);
         }
     }
+    endBulkUpdate();
+    DiagramElement::endEmbeddedDefinitions();
     // Aufräumen
     insertedItem = nullptr;
     insertedDrawItem = nullptr;
@@ -1426,6 +2915,9 @@ void DiagramScene::addElementToJSON(QGraphicsItem *item, QJsonArray &array)
         }
         json["children"]=ar;
     }
+    if(!item->parentItem() && !layerOf(item).isEmpty()){
+        json["layer"]=layerOf(item);
+    }
     if(item->type()>QGraphicsItem::UserType){
         switch (item->type()) {
         case DiagramTextItem::Type:
@@ -1453,6 +2945,13 @@ void DiagramScene::addElementToJSON(QGraphicsItem *item, QJsonArray &array)
         }
             break;
         }
+        // locking is session state, write the flags the item had before
+        const QVariant locked=item->data(LockData);
+        if(locked.isValid() && json.contains("selectable")){
+            const int saved=locked.toList().at(0).toInt();
+            json["moveable"]=(saved&QGraphicsItem::ItemIsMovable)!=0;
+            json["selectable"]=(saved&QGraphicsItem::ItemIsSelectable)!=0;
+        }
         array.append(json);
     }
     if(item->type()==QGraphicsItemGroup::Type){
@@ -1501,6 +3000,18 @@ QGraphicsItem *DiagramScene::getElementFromJSON(QJsonObject json)
         insertedSplineItem = new DiagramSplineItem(json,myItemMenu);
         item=insertedSplineItem;
         break;
+    case DiagramSymbol::Type:
+    {
+        const QString name=json["symbol"].toString();
+        DiagramSymbol::DefinitionPtr def=m_symbols.value(name);
+        if(!def){
+            qWarning("Undefined symbol %s",qPrintable(name));
+            def=placeholderSymbol(name);
+        }
+        insertedItem = new DiagramSymbol(json,def,myItemMenu);
+        item=insertedItem;
+    }
+        break;
     case DiagramTextItem::Type:
         textItem = new DiagramTextItem(json);
         textItem->setTextInteractionFlags(Qt::NoTextInteraction);
@@ -1509,7 +3020,7 @@ QGraphicsItem *DiagramScene::getElementFromJSON(QJsonObject json)
         connect(textItem, &DiagramTextItem::receivedFocus,
                 this, &DiagramScene::editorReceivedFocus);
         connect(textItem, &DiagramTextItem::selectedChange,
-                this, &DiagramScene::itemSelected);
+                this, &DiagramScene::textItemSelected);
         item=textItem;
         break;
     case QGraphicsItemGroup::Type:
@@ -1529,6 +3040,9 @@ QGraphicsItem *DiagramScene::getElementFromJSON(QJsonObject json)
             QGraphicsItemGroup *ig=createItemGroup(children);
             ig->setFlag(QGraphicsItem::ItemIsMovable, true);
             ig->setFlag(QGraphicsItem::ItemIsSelectable, true);
+            if(json.contains("layer")){
+                ig->setData(LayerData,json["layer"].toString());
+            }
             return ig;
         }
     }
@@ -1536,6 +3050,9 @@ QGraphicsItem *DiagramScene::getElementFromJSON(QJsonObject json)
     default:
         break;
     }
+    if(item && json.contains("layer")){
+        item->setData(LayerData,json["layer"].toString());
+    }
     // handle children
     if(json["children"].isArray()){
         QJsonArray array=json["children"].toArray();
@@ -1608,8 +3125,8 @@ void DiagramScene::setArrow(const int i)
     if(insertedSplineItem!=0){
         insertedSplineItem->setDiagramType(DiagramSplineItem::DiagramType(myArrow));
     }
-    if (!selectedItems().empty()){
-        foreach(QGraphicsItem* item,selectedItems()){
+    if (!selection().empty()){
+        foreach(QGraphicsItem* item,selection()){
             switch(item->type()){
             case DiagramPathItem::Type:
                 qgraphicsitem_cast<DiagramPathItem*>(item)->setDiagramType(DiagramPathItem::DiagramType(myArrow));
@@ -1621,6 +3138,7 @@ void DiagramScene::setArrow(const int i)
                 // nothing to do
                 break;
             }
+            trackBounds(item);
         }
     }
 }
@@ -57,10 +57,16 @@
 #include "diagramtextitem.h"
 #include "diagrampathitem.h"
 #include "diagramsplineitem.h"
+#include "diagramsymbol.h"
+#include "dragpreviewitem.h"
 
 #include <QGraphicsScene>
+#include <QGraphicsSceneMouseEvent>
 #include <QFile>
 #include <QJsonDocument>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
 
 QT_BEGIN_NAMESPACE
 class QGraphicsSceneMouseEvent;
@@ -78,8 +84,11 @@ class DiagramScene : public QGraphicsScene
 
 public:
     enum Mode { InsertItem, InsertLine, InsertSpline, InsertText, MoveItem, CopyItem, CopyingItem, InsertDrawItem, Zoom , MoveItems, InsertElement , ZoomSingle, InsertUserElement};
+    // keys for QGraphicsItem::data()
+    enum ItemData { LayerData=100, LockData };
 
     explicit DiagramScene(QMenu *itemMenu, QObject *parent = nullptr);
+    ~DiagramScene() override;
     QFont font() const { return myFont; }
     QColor textColor() const { return myTextColor; }
     QColor itemColor() const { return myItemColor; }
@@ -113,9 +122,17 @@ public:
     {
         myGridScale=k;
     }
+    int gridScale() const
+    {
+        return myGridScale;
+    }
 
     bool save_json(QFile *file,bool selectedItemsOnly=false);
     QJsonDocument create_json_save(bool selectedItemsOnly=false);
+    QImage renderPreview(int size);
+    QImage renderPreview(const QJsonArray &items, int size);
+    static QJsonObject readHeader(const QString &fileName);
+    static QImage headerPreview(const QJsonObject &header);
     bool load_json(QFile *file);
     void read_in_json(QJsonDocument doc);
     void addElementToJSON(QGraphicsItem* item,QJsonArray &array);
@@ -127,9 +144,16 @@ public:
     void deleteItem(QGraphicsItem *item);
     void insertElementDirectly(const QString element);
     QList<QGraphicsItem *> activeItems() const;
+    const QList<QGraphicsItem *> &selection() const;
+    void selectItems(const QList<QGraphicsItem *> &items, bool select=true);
+    void selectAllItems();
     void duplicateItems();
 
     void setMaxZ(qreal z);
+    void bringToFront(QList<QGraphicsItem *> lst);
+    void sendToBack(QList<QGraphicsItem *> lst);
+    void bringUp(QList<QGraphicsItem *> lst);
+    void sendDown(QList<QGraphicsItem *> lst);
 
     void takeSnapshot();
     void restoreSnapshot(int pos=-1);
@@ -137,6 +161,37 @@ public:
     int getSnapshotSize();
 
     void backoutOne();
+    void beginBulkUpdate();
+    void endBulkUpdate();
+
+    QList<QGraphicsItem *> itemsInRect(const QRectF &rect) const;
+    void flushDragPreview();
+    QRectF contentBounds() const;
+    int itemCount() const;
+    void fitSceneRect();
+
+    QStringList layers() const;
+    void addLayer(const QString &name);
+    void removeLayer(const QString &name);
+    void resetLayers();
+    void setCurrentLayer(const QString &name);
+    QString currentLayer() const;
+    void setLayerVisible(const QString &name, bool visible);
+    bool isLayerVisible(const QString &name) const;
+    void setLayerLocked(const QString &name, bool locked);
+    bool isLayerLocked(const QString &name) const;
+    void moveToLayer(const QList<QGraphicsItem *> &items, const QString &name);
+    static QString layerOf(const QGraphicsItem *item);
+
+    DiagramSymbol::DefinitionPtr symbolDefinition(const QString &name) const;
+    void resetSymbols();
+    void libraryFileChanged(const QString &fn);
+    void setEmbedElements(bool embed);
+    bool embedElements() const;
+
+    static void itemChanged(QGraphicsItem *item, QGraphicsItem::GraphicsItemChange change);
+    static void itemGeometryChanged(QGraphicsItem *item);
+    static void itemDestroyed(QGraphicsItem *item);
 
     QRectF getTotalBoundary(const QList<QGraphicsItem*> items) const;
     static void filterSelectedChildItems(QList<QGraphicsItem*> &lst);
@@ -154,6 +209,7 @@ public slots:
     void clear();
     void copyToBuffer();
     void pasteFromBuffer();
+    void flushMouseMove();
 
 signals:
     void itemInserted(DiagramItem *item);
@@ -166,6 +222,9 @@ signals:
     void zoomPointer(const qreal factor,QPointF pointer);
     void forceCursor(QPointF p);
     void abortSignal();
+    void layersChanged();
+    void snapshotTaken(const QJsonDocument &doc);
+    void contentChanged(const QRectF &rect);
 
 protected:
     void mousePressEvent(QGraphicsSceneMouseEvent *mouseEvent) override;
@@ -178,7 +237,38 @@ protected:
     void drawBackground(QPainter *p, const QRectF &r) override;
     void enableAllItems(bool enable=true);
     DiagramTextItem *makeTextItem(QGraphicsItem *item);
-    DiagramItem *load_userElement(const QString &fn);
+    DiagramSymbol *load_userElement(const QString &fn);
+    DiagramSymbol::DefinitionPtr defineSymbol(const QString &name, const QJsonArray &items);
+    DiagramSymbol::DefinitionPtr placeholderSymbol(const QString &name);
+    void readSymbols(const QJsonDocument &doc);
+    bool readSymbol(const QJsonObject &symbols, const QString &name, QHash<QString, bool> &done, QStringList &visiting);
+    static void collectSymbolNames(const QJsonArray &items, QSet<QString> &names);
+    static QJsonArray documentItems(const QJsonDocument &doc);
+    void collectSymbols(const QGraphicsItem *item, QMap<QString, DiagramSymbol::DefinitionPtr> &symbols) const;
+    void collectSymbol(const QString &name, const DiagramSymbol::DefinitionPtr &def, QMap<QString, DiagramSymbol::DefinitionPtr> &symbols) const;
+    QList<QGraphicsItem *> createItems(const QJsonArray &array);
+    QJsonDocument embedElementDefinitions(const QJsonDocument &doc) const;
+    static void collectElements(const QJsonArray &items, QSet<QString> &hashes);
+    static void collectElementFiles(const QJsonArray &items, QSet<QString> &files);
+    QJsonObject documentHeader(const QJsonDocument &doc, bool selectedItemsOnly);
+    void processMouseMove(QGraphicsSceneMouseEvent *mouseEvent);
+    void textItemSelected(QGraphicsItem *item);
+    void emitTextItemSelected();
+    void finishBulkSelection();
+    bool isZOrdered(const QGraphicsItem *item) const;
+    void prepareZOrder(QList<QGraphicsItem *> &lst) const;
+    void checkZOrder(qreal gap);
+    void renormalizeZ();
+    void refreshEditedItems();
+    void trackBounds(QGraphicsItem *item);
+    void untrackBounds(QGraphicsItem *item);
+    bool touchesContentEdge(const QRectF &rect) const;
+    void growSceneRect();
+    QList<QGraphicsItem *> layerItems(const QString &name) const;
+    void lockItem(QGraphicsItem *item, bool lock);
+    void assignLayer(QGraphicsItem *item);
+    void moveItemsBy(const QList<QGraphicsItem*> &items, qreal dx, qreal dy);
+    void dragItemsBy(const QList<QGraphicsItem*> &items, qreal dx, qreal dy);
 
 
 private:
@@ -217,8 +307,47 @@ private:
     int myGridScale;
     QList<QGraphicsItem*> myMoveItems;
     qreal maxZ;
+    qreal minZ;
+    QTimer m_zOrderTimer;
+    // bulk insertion/removal
+    int m_bulkUpdate;
+    ItemIndexMethod m_bulkIndexMethod;
+    // scene bounding rect of every diagram item, the union is the content bounds
+    QHash<QGraphicsItem*,QRectF> m_itemBounds;
+    mutable QRectF m_contentBounds;
+    mutable bool m_contentBoundsDirty;
+    // while a mouse button is down the bounds only grow, shrinking waits for the release
+    bool m_growOnly;
+    bool m_shrinkPending;
+    QRectF m_pendingGrowth;
+    QTimer m_sceneRectTimer;
+    // layers, "" is the default layer which is always visible and unlocked
+    QStringList m_layers;
+    QString m_currentLayer;
+    QSet<QString> m_lockedLayers;
+    // top level items of hidden layers, kept out of the scene
+    QHash<QString,QList<QGraphicsItem*>> m_hiddenItems;
+    // symbol definitions of the document, and user element file -> symbol name
+    QHash<QString,DiagramSymbol::DefinitionPtr> m_symbols;
+    QHash<QString,QString> m_symbolFiles;
+    // save element definitions with the document
+    bool m_embedElements;
     QList<QJsonDocument> m_snapshots;
     int m_undoPos;
+    // mouse move coalescing
+    QTimer m_moveTimer;
+    QGraphicsSceneMouseEvent m_pendingMove;
+    bool m_movePending;
+    QPointF m_lastDragDelta;
+    bool m_dragDeltaValid;
+    DragPreviewItem *m_dragPreview;
+    // cached selectedItems(), rebuilt on first access after a change
+    mutable QList<QGraphicsItem*> m_selection;
+    mutable bool m_selectionDirty;
+    // selection notifications
+    int m_bulkSelection;
+    QPointer<DiagramTextItem> m_selectedTextItem;
+    bool m_textSelectionQueued;
 };
 
 #endif // DIAGRAMSCENE_H
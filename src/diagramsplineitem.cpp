@@ -3,6 +3,7 @@
 #include <QtGui>
 #include <QGraphicsSceneMouseEvent>
 #include "diagramscene.h"
+#include "paintstatistics.h"
 
 
 DiagramSplineItem::DiagramSplineItem(DiagramType diagramType,QMenu *, QGraphicsItem *parent):QGraphicsPathItem(parent)
@@ -261,8 +262,20 @@ void DiagramSplineItem::createPath()
     setPath(path);
 }
 
+DiagramSplineItem::~DiagramSplineItem()
+{
+    DiagramScene::itemDestroyed(this);
+}
+
+QVariant DiagramSplineItem::itemChange(GraphicsItemChange change, const QVariant &value)
+{
+    DiagramScene::itemChanged(this,change);
+    return value;
+}
+
 void DiagramSplineItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
 {
+    PaintTimer timer(Type);
     painter->setPen(pen());
     painter->setBrush(brush());
     QPainterPath path;
@@ -11,6 +11,7 @@ public:
     DiagramSplineItem(DiagramType diagramType, QMenu *contextMenu, QGraphicsItem *parent=nullptr);
     DiagramSplineItem(const QJsonObject &json, QMenu *contextMenu);
     DiagramSplineItem(const DiagramSplineItem& diagram);//copy constructor
+    ~DiagramSplineItem();
 
     int type() const
         { return Type;}
@@ -30,6 +31,7 @@ public:
     QPixmap icon();
 
 protected:
+    QVariant itemChange(GraphicsItemChange change, const QVariant &value);
     QRectF boundingRect() const;
     QPainterPath shape() const;
     void paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *);
@@ -0,0 +1,83 @@
+#include "diagramsymbol.h"
+#include "diagramscene.h"
+#include "paintstatistics.h"
+#include <QPainter>
+#include <QJsonObject>
+
+DiagramSymbol::DiagramSymbol(DefinitionPtr definition, QMenu *contextMenu, QGraphicsItem *parent)
+    : DiagramItem(contextMenu,parent)
+{
+    setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+    setPen(Qt::NoPen);
+    setBrush(Qt::NoBrush);
+    setDefinition(definition);
+}
+
+DiagramSymbol::DiagramSymbol(const QJsonObject &json, DefinitionPtr definition, QMenu *contextMenu)
+    : DiagramItem(json,contextMenu)
+{
+    setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+    setPen(Qt::NoPen);
+    setBrush(Qt::NoBrush);
+    setDefinition(definition);
+}
+
+DiagramSymbol::DiagramSymbol(const DiagramSymbol &symbol)
+    : DiagramItem(symbol.myContextMenu,symbol.parentItem())
+{
+    setFlag(QGraphicsItem::ItemSendsGeometryChanges, true);
+    setPen(Qt::NoPen);
+    setBrush(Qt::NoBrush);
+    setDefinition(symbol.mDefinition);
+    setTransform(symbol.transform());
+    setPos(symbol.pos());
+}
+
+DiagramItem *DiagramSymbol::copy()
+{
+    return new DiagramSymbol(*this);
+}
+
+void DiagramSymbol::write(QJsonObject &obj)
+{
+    DiagramItem::write(obj);
+    obj["symbol"]=symbolName();
+}
+
+DiagramSymbol::DefinitionPtr DiagramSymbol::definition() const
+{
+    return mDefinition;
+}
+/*!
+ * \brief use other definition, e.g. after the user element was changed
+ * \param definition
+ */
+void DiagramSymbol::setDefinition(DefinitionPtr definition)
+{
+    mDefinition=definition;
+    setBoundingBox(mDefinition ? mDefinition->bounds : QRectF());
+    DiagramScene::itemGeometryChanged(this);
+    update();
+}
+
+QString DiagramSymbol::symbolName() const
+{
+    return mDefinition ? mDefinition->name : QString();
+}
+
+void DiagramSymbol::paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *)
+{
+    PaintTimer timer(Type);
+    if(mDefinition){
+        painter->drawPicture(0,0,mDefinition->picture);
+    }
+    // selected
+    if(isSelected()){
+        QPen selPen=QPen(Qt::DotLine);
+        selPen.setWidth(0);
+        selPen.setColor(Qt::black);
+        painter->setBrush(Qt::NoBrush);
+        painter->setPen(selPen);
+        painter->drawRect(boundingRect());
+    }
+}
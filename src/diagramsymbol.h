@@ -0,0 +1,52 @@
+#ifndef DIAGRAMSYMBOL_H
+#define DIAGRAMSYMBOL_H
+
+#include "diagramitem.h"
+#include <QJsonArray>
+#include <QPicture>
+#include <QSharedPointer>
+
+/*!
+ * \brief placed instance of a user element
+ * The items of the user element are stored once per document as symbol
+ * definition. An instance only keeps a reference to it together with its
+ * position and transform, and plays back the recorded drawing of the
+ * definition.
+ */
+class DiagramSymbol : public DiagramItem
+{
+public:
+    enum { Type = UserType + 33 };
+
+    struct Definition {
+        QString name;
+        // items relative to the symbol origin, as written to file
+        QJsonArray items;
+        QRectF bounds;
+        QPicture picture;
+        // stand-in for a missing definition, not written to file
+        bool placeholder=false;
+    };
+    typedef QSharedPointer<const Definition> DefinitionPtr;
+
+    DiagramSymbol(DefinitionPtr definition, QMenu *contextMenu, QGraphicsItem *parent = nullptr);
+    DiagramSymbol(const QJsonObject &json, DefinitionPtr definition, QMenu *contextMenu);
+    DiagramSymbol(const DiagramSymbol &symbol);//copy constructor
+
+    DiagramItem* copy() override;
+    void write(QJsonObject &obj) override;
+    int type() const override
+        { return Type; }
+
+    DefinitionPtr definition() const;
+    void setDefinition(DefinitionPtr definition);
+    QString symbolName() const;
+
+protected:
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *, QWidget *) override;
+
+private:
+    DefinitionPtr mDefinition;
+};
+
+#endif // DIAGRAMSYMBOL_H
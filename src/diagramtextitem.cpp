@@ -50,6 +50,7 @@
 
 #include "diagramtextitem.h"
 #include "diagramscene.h"
+#include "paintstatistics.h"
 #include <QTextBlockFormat>
 #include <QTextDocument>
 #include <QTextCursor>
@@ -129,14 +130,26 @@ DiagramTextItem::DiagramTextItem(const QJsonObject &json)
              this, SLOT(updateGeometry(int,int,int)));
 
 }
+DiagramTextItem::~DiagramTextItem()
+{
+    DiagramScene::itemDestroyed(this);
+}
+
 QVariant DiagramTextItem::itemChange(GraphicsItemChange change,
                      const QVariant &value)
 {
+    DiagramScene::itemChanged(this,change);
     if (change == QGraphicsItem::ItemSelectedHasChanged)
         emit selectedChange(this);
     return value;
 }
 
+void DiagramTextItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    PaintTimer timer(Type);
+    QGraphicsTextItem::paint(painter,option,widget);
+}
+
 void DiagramTextItem::focusOutEvent(QFocusEvent *event)
 {
     setTextInteractionFlags(Qt::NoTextInteraction);
@@ -312,5 +325,6 @@ void DiagramTextItem::updateGeometry()
     m_offset=calcOffset();
     setPos(m_anchorPoint+m_offset);
     m_updateGeometry=false;
+    DiagramScene::itemGeometryChanged(this);
 }
 
@@ -67,6 +67,7 @@ public:
     DiagramTextItem(QGraphicsItem *parent = nullptr);
     DiagramTextItem(const DiagramTextItem& textItem);
     DiagramTextItem(const QJsonObject& json);
+    ~DiagramTextItem() override;
 
     DiagramTextItem* copy();
     void write(QJsonObject &json);
@@ -98,6 +99,7 @@ signals:
 
 protected:
     QVariant itemChange(GraphicsItemChange change, const QVariant &value) override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget) override;
     void focusOutEvent(QFocusEvent *event) override;
     void focusInEvent(QFocusEvent *event) override;
     void mouseDoubleClickEvent(QGraphicsSceneMouseEvent *event) override;
@@ -0,0 +1,391 @@
+#include "diagramview.h"
+#include "diagramscene.h"
+#include "paintstatistics.h"
+#include "performancehud.h"
+#include "tilecache.h"
+#include "tilerenderer.h"
+
+#include <QElapsedTimer>
+#include <QNativeGestureEvent>
+#include <QPaintEvent>
+#include <QPainter>
+#include <QRubberBand>
+#include <QScrollBar>
+#include <QStyleOption>
+#include <QtMath>
+
+// time per paint spent on rendering missing tiles, the rest is previewed
+static const int tileRenderBudget=12;
+// share of the remaining zoom applied per animation frame
+static const qreal zoomStep=0.35;
+
+DiagramView::DiagramView(QGraphicsScene *scene, QWidget *parent)
+    : QGraphicsView(scene, parent)
+{
+    m_hud=new PerformanceHud(this);
+    m_hud->hide();
+    m_renderMode=DirectRendering;
+    m_tiles=nullptr;
+    m_renderer=nullptr;
+    m_previewScale=0;
+    m_previewBackground=0;
+    m_tileTimer.setSingleShot(true);
+    m_tileTimer.setInterval(0);
+    connect(&m_tileTimer,&QTimer::timeout,viewport(),QOverload<>::of(&QWidget::update));
+    m_zoomTarget=1.0;
+    m_zoomTimer.setInterval(16);
+    connect(&m_zoomTimer,&QTimer::timeout,this,&DiagramView::zoomFrame);
+    // grid and caches are only adapted when no more input follows
+    m_settleTimer.setSingleShot(true);
+    m_settleTimer.setInterval(150);
+    connect(&m_settleTimer,&QTimer::timeout,this,&DiagramView::zoomSettled);
+}
+
+DiagramView::~DiagramView()
+{
+    delete m_tiles;
+}
+/*!
+ * \brief show/hide performance overlay
+ * Paint statistics are only collected while the overlay is visible.
+ * \param visible
+ */
+void DiagramView::setHudVisible(bool visible)
+{
+    PaintStatistics::setEnabled(visible);
+    m_hud->setVisible(visible);
+    viewport()->update();
+}
+
+bool DiagramView::isHudVisible() const
+{
+    return m_hud->isVisible();
+}
+/*!
+ * \brief select how the scene is painted
+ * In the tiled modes the viewport is composed from cached tiles, kept per
+ * zoom level and dropped when the scene reports changes in their area.
+ * Panning and returning to a former zoom level only copies pixmaps.
+ * ParallelRendering rasterizes missing tiles on the thread pool, it falls
+ * back to TiledRendering if the platform cannot render text in threads.
+ * \param mode
+ */
+void DiagramView::setRenderMode(RenderMode mode)
+{
+    if(mode==ParallelRendering && !TileRenderer::isSupported()){
+        mode=TiledRendering;
+    }
+    if(mode==m_renderMode){
+        return;
+    }
+    if(mode!=DirectRendering && !m_tiles){
+        m_tiles=new TileCache;
+        if(scene()){
+            connect(scene(),&QGraphicsScene::changed,this,&DiagramView::sceneChanged);
+        }
+    }
+    if(mode==DirectRendering && m_tiles){
+        if(scene()){
+            disconnect(scene(),&QGraphicsScene::changed,this,&DiagramView::sceneChanged);
+        }
+        m_tileTimer.stop();
+        delete m_tiles;
+        m_tiles=nullptr;
+    }
+    if(mode==ParallelRendering){
+        m_renderer=new TileRenderer(this);
+        connect(m_renderer,&TileRenderer::tileRendered,this,&DiagramView::tileRendered);
+        connect(m_renderer,&TileRenderer::finished,viewport(),QOverload<>::of(&QWidget::update));
+    }else{
+        delete m_renderer;
+        m_renderer=nullptr;
+    }
+    m_renderMode=mode;
+    m_previewScale=0;
+    viewport()->update();
+}
+
+DiagramView::RenderMode DiagramView::renderMode() const
+{
+    return m_renderMode;
+}
+/*!
+ * \brief drop all cached tiles
+ */
+void DiagramView::invalidateTiles()
+{
+    if(m_tiles){
+        m_tiles->clear();
+        m_previewScale=0;
+        viewport()->update();
+    }
+}
+
+void DiagramView::sceneChanged(const QList<QRectF> &region)
+{
+    for(const QRectF &rect:region){
+        m_tiles->invalidate(rect);
+        if(m_renderer){
+            m_renderer->invalidate(rect);
+        }
+    }
+}
+/*!
+ * \brief store tile from the worker threads and show it if visible
+ */
+void DiagramView::tileRendered(qreal scale, int background, int x, int y, const QImage &image)
+{
+    m_tiles->insert(scale,background,x,y,QPixmap::fromImage(image));
+    const QTransform t=viewportTransform();
+    if(t.m11()==scale && backgroundKey()==background){
+        const int size=TileCache::tileSize;
+        const QPoint origin(qRound(t.dx()),qRound(t.dy()));
+        viewport()->update(QRect(origin+QPoint(x,y)*size,QSize(size,size)));
+    }
+}
+/*!
+ * \brief zoom by factor, keeping scenePos at its place in the viewport
+ * Successive calls accumulate, the view approaches the target scale with
+ * one transform change per frame. zoomSettled() is emitted when the
+ * animation has ended and no further input followed.
+ * \param factor
+ * \param scenePos anchor
+ */
+void DiagramView::zoomAt(qreal factor, const QPointF &scenePos)
+{
+    if(!m_zoomTimer.isActive()){
+        m_zoomTarget=transform().m11();
+    }
+    m_zoomTarget=qBound(0.001,m_zoomTarget*factor,1000.0);
+    m_zoomAnchor=scenePos;
+    m_zoomAnchorView=viewportTransform().map(scenePos);
+    m_settleTimer.stop();
+    if(!m_zoomTimer.isActive()){
+        m_zoomTimer.start();
+        zoomFrame();
+    }
+}
+
+bool DiagramView::isZooming() const
+{
+    return m_zoomTimer.isActive();
+}
+
+void DiagramView::zoomFrame()
+{
+    const qreal current=transform().m11();
+    qreal scale=current*qPow(m_zoomTarget/current,zoomStep);
+    if(qAbs(m_zoomTarget/scale-1.0)<0.005){
+        scale=m_zoomTarget;
+        m_zoomTimer.stop();
+        m_settleTimer.start();
+        // render sharp tiles for the final scale
+        viewport()->update();
+    }
+    setTransform(QTransform::fromScale(scale,scale));
+    const QPointF offset=viewportTransform().map(m_zoomAnchor)-m_zoomAnchorView;
+    horizontalScrollBar()->setValue(horizontalScrollBar()->value()+qRound(offset.x()));
+    verticalScrollBar()->setValue(verticalScrollBar()->value()+qRound(offset.y()));
+}
+/*!
+ * \brief handle pinch gestures of touchpads
+ * \param event
+ * \return
+ */
+bool DiagramView::viewportEvent(QEvent *event)
+{
+    if(event->type()==QEvent::NativeGesture){
+        auto *gesture=static_cast<QNativeGestureEvent*>(event);
+        if(gesture->gestureType()==Qt::ZoomNativeGesture){
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+            const QPointF pos=gesture->position();
+#else
+            const QPointF pos=gesture->localPos();
+#endif
+            zoomAt(1.0+gesture->value(),mapToScene(pos.toPoint()));
+            return true;
+        }
+    }
+    return QGraphicsView::viewportEvent(event);
+}
+/*!
+ * \brief paint event
+ * Frames the paint statistics when the HUD is active
+ * \param event
+ */
+void DiagramView::paintEvent(QPaintEvent *event)
+{
+    if(!PaintStatistics::isEnabled()){
+        paintViewport(event);
+        return;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    PaintStatistics::beginFrame();
+    paintViewport(event);
+    PaintStatistics::endFrame(timer.nsecsElapsed());
+}
+
+void DiagramView::paintViewport(QPaintEvent *event)
+{
+    const QTransform t=viewportTransform();
+    // tiles are only aligned for plain scaling
+    if(!m_tiles || !scene() || t.type()>QTransform::TxScale || t.m11()!=t.m22()){
+        QGraphicsView::paintEvent(event);
+        return;
+    }
+    paintTiles(event);
+}
+/*!
+ * \brief compose exposed region from tiles
+ * Missing tiles are rendered until the time budget is used up, or handed
+ * to the thread pool in ParallelRendering. Meanwhile stale tiles are shown
+ * as they are, others are covered by the scaled tiles of the last completely
+ * painted zoom level. During a zoom animation only the preview is painted.
+ * \param event
+ */
+void DiagramView::paintTiles(QPaintEvent *event)
+{
+    const int size=TileCache::tileSize;
+    const QTransform t=viewportTransform();
+    const qreal scale=t.m11();
+    const int background=backgroundKey();
+    const QPoint origin(qRound(t.dx()),qRound(t.dy()));
+    const QRect range=TileCache::tileRange(event->rect().translated(-origin));
+
+    const bool zooming=isZooming();
+    QPainter painter(viewport());
+    QElapsedTimer timer;
+    timer.start();
+    QList<QPoint> missing;
+    for(int y=range.top();y<=range.bottom();++y){
+        for(int x=range.left();x<=range.right();++x){
+            const QRect target(origin+QPoint(x,y)*size,QSize(size,size));
+            if(!event->region().intersects(target)){
+                continue;
+            }
+            bool stale=false;
+            QPixmap *pixmap=m_tiles->tile(scale,background,x,y,&stale);
+            if(pixmap && !stale){
+                painter.drawPixmap(target.topLeft(),*pixmap);
+                continue;
+            }
+            if(m_renderMode==TiledRendering && !zooming && timer.elapsed()<tileRenderBudget){
+                const QPixmap rendered=renderTile(scale,x,y);
+                painter.drawPixmap(target.topLeft(),rendered);
+                m_tiles->insert(scale,background,x,y,rendered);
+                continue;
+            }
+            if(pixmap){
+                painter.drawPixmap(target.topLeft(),*pixmap);
+            }else{
+                paintPreview(painter,target,scale,origin);
+            }
+            missing<<QPoint(x,y);
+        }
+    }
+    paintRubberBand(painter);
+    if(missing.isEmpty()){
+        m_previewScale=scale;
+        m_previewBackground=background;
+    }else if(!zooming){
+        // the end of the animation or of a running batch triggers a repaint
+        if(m_renderer){
+            m_renderer->render(scene(),scale,background,missing,viewport()->devicePixelRatioF(),renderHints());
+        }else{
+            m_tileTimer.start();
+        }
+    }
+}
+/*!
+ * \brief cover target with scaled tiles of the last complete zoom level
+ * \param painter
+ * \param target tile rect in viewport coordinates
+ * \param scale current zoom level
+ * \param origin viewport position of the scene origin
+ */
+void DiagramView::paintPreview(QPainter &painter, const QRect &target, qreal scale, const QPoint &origin)
+{
+    painter.fillRect(target,Qt::white);
+    if(m_previewScale<=0 || m_previewScale==scale){
+        return;
+    }
+    const QRect local=target.translated(-origin);
+    const QRectF sceneRect(QPointF(local.topLeft())/scale,QSizeF(local.size())/scale);
+    const QRectF previewRect(sceneRect.topLeft()*m_previewScale,sceneRect.size()*m_previewScale);
+    const QRect range=TileCache::tileRange(previewRect.toAlignedRect());
+    // after zooming out far, the old level has too many small tiles to be worth it
+    if(range.width()*range.height()>16){
+        return;
+    }
+    painter.save();
+    painter.setClipRect(target,Qt::IntersectClip);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform,false);
+    for(int y=range.top();y<=range.bottom();++y){
+        for(int x=range.left();x<=range.right();++x){
+            QPixmap *pixmap=m_tiles->tile(m_previewScale,m_previewBackground,x,y);
+            if(!pixmap){
+                continue;
+            }
+            const QRectF source=TileCache::sceneRect(m_previewScale,x,y);
+            const QRectF rect(source.topLeft()*scale+QPointF(origin),source.size()*scale);
+            painter.drawPixmap(rect,*pixmap,QRectF(pixmap->rect()));
+        }
+    }
+    painter.restore();
+}
+/*!
+ * \brief paint rubber band of the selection drag
+ * QGraphicsView::paintEvent() is bypassed in tiled mode.
+ * \param painter
+ */
+void DiagramView::paintRubberBand(QPainter &painter)
+{
+    if(dragMode()!=RubberBandDrag || rubberBandRect().isEmpty()){
+        return;
+    }
+    QStyleOptionRubberBand option;
+    option.initFrom(viewport());
+    option.rect=rubberBandRect();
+    option.shape=QRubberBand::Rectangle;
+    painter.save();
+    QStyleHintReturnMask mask;
+    if(viewport()->style()->styleHint(QStyle::SH_RubberBand_Mask,&option,viewport(),&mask)){
+        painter.setClipRegion(mask.region,Qt::IntersectClip);
+    }
+    viewport()->style()->drawControl(QStyle::CE_RubberBand,&option,&painter,viewport());
+    painter.restore();
+}
+/*!
+ * \brief render one tile of the scene
+ * \param scale zoom level
+ * \param x
+ * \param y
+ * \return
+ */
+QPixmap DiagramView::renderTile(qreal scale, int x, int y) const
+{
+    const int size=TileCache::tileSize;
+    const qreal ratio=viewport()->devicePixelRatioF();
+    QPixmap pixmap(qCeil(size*ratio),qCeil(size*ratio));
+    pixmap.setDevicePixelRatio(ratio);
+    pixmap.fill(Qt::white);
+    QPainter painter(&pixmap);
+    painter.setRenderHints(renderHints());
+    scene()->render(&painter,QRectF(0,0,size,size),TileCache::sceneRect(scale,x,y),Qt::IgnoreAspectRatio);
+    return pixmap;
+}
+/*!
+ * \brief key of the scene background
+ * The grid spacing depends on the zoom, tiles with another spacing must
+ * not be reused.
+ * \return
+ */
+int DiagramView::backgroundKey() const
+{
+    auto *diagram=qobject_cast<DiagramScene*>(scene());
+    if(!diagram || !diagram->isGridVisible()){
+        return 0;
+    }
+    return qRound(diagram->grid()*diagram->gridScale()*100);
+}
@@ -0,0 +1,67 @@
+#ifndef DIAGRAMVIEW_H
+#define DIAGRAMVIEW_H
+
+#include <QGraphicsView>
+#include <QTimer>
+
+class PerformanceHud;
+class TileCache;
+class TileRenderer;
+
+class DiagramView : public QGraphicsView
+{
+    Q_OBJECT
+
+public:
+    enum RenderMode { DirectRendering, TiledRendering, ParallelRendering };
+
+    explicit DiagramView(QGraphicsScene *scene, QWidget *parent = nullptr);
+    ~DiagramView() override;
+
+    void setHudVisible(bool visible);
+    bool isHudVisible() const;
+
+    void setRenderMode(RenderMode mode);
+    RenderMode renderMode() const;
+    void invalidateTiles();
+
+    void zoomAt(qreal factor, const QPointF &scenePos);
+    bool isZooming() const;
+
+signals:
+    void zoomSettled();
+
+protected:
+    bool viewportEvent(QEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void paintViewport(QPaintEvent *event);
+    void paintTiles(QPaintEvent *event);
+    void paintPreview(QPainter &painter, const QRect &target, qreal scale, const QPoint &origin);
+    void paintRubberBand(QPainter &painter);
+    QPixmap renderTile(qreal scale, int x, int y) const;
+    int backgroundKey() const;
+
+private slots:
+    void sceneChanged(const QList<QRectF> &region);
+    void tileRendered(qreal scale, int background, int x, int y, const QImage &image);
+    void zoomFrame();
+
+private:
+    PerformanceHud *m_hud;
+    RenderMode m_renderMode;
+    TileCache *m_tiles;
+    TileRenderer *m_renderer;
+    // remaining tiles are rendered in later passes
+    QTimer m_tileTimer;
+    // last zoom level painted completely, scaled as preview while zooming
+    qreal m_previewScale;
+    int m_previewBackground;
+    // zoom input is accumulated and applied once per frame
+    QTimer m_zoomTimer;
+    QTimer m_settleTimer;
+    qreal m_zoomTarget;
+    QPointF m_zoomAnchor;
+    QPointF m_zoomAnchorView;
+};
+
+#endif // DIAGRAMVIEW_H
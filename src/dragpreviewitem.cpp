@@ -0,0 +1,61 @@
+#include "dragpreviewitem.h"
+
+#include <QPainter>
+#include <QStyleOptionGraphicsItem>
+
+DragPreviewItem::DragPreviewItem(const QList<QGraphicsItem *> &items)
+    : m_items(items)
+{
+    setFlag(QGraphicsItem::ItemIsSelectable, false);
+    setAcceptedMouseButtons(Qt::NoButton);
+    for(QGraphicsItem *item:m_items){
+        m_rect|=item->mapRectToScene(item->boundingRect()|item->childrenBoundingRect());
+        m_opacities.append(item->opacity());
+        item->setOpacity(0.0);
+    }
+}
+/*!
+ * \brief make the dragged items visible again
+ */
+void DragPreviewItem::restore()
+{
+    for(int i=0;i<m_items.size();++i){
+        m_items[i]->setOpacity(m_opacities[i]);
+    }
+}
+
+QRectF DragPreviewItem::boundingRect() const
+{
+    return m_rect;
+}
+
+void DragPreviewItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    for(QGraphicsItem *item:m_items){
+        paintItem(item,painter,option,widget);
+    }
+}
+/*!
+ * \brief paint item and its children in their scene position
+ * \param item
+ * \param painter
+ * \param option
+ * \param widget
+ */
+void DragPreviewItem::paintItem(QGraphicsItem *item, QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    QStyleOptionGraphicsItem opt(*option);
+    opt.exposedRect=item->boundingRect();
+    if(item->isSelected()){
+        opt.state|=QStyle::State_Selected;
+    }else{
+        opt.state&=~QStyle::State_Selected;
+    }
+    painter->save();
+    painter->setTransform(item->sceneTransform(),true);
+    item->paint(painter,&opt,widget);
+    painter->restore();
+    for(QGraphicsItem *child:item->childItems()){
+        paintItem(child,painter,option,widget);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef DRAGPREVIEWITEM_H
+#define DRAGPREVIEWITEM_H
+
+#include <QGraphicsItem>
+#include <QList>
+#include <QVector>
+
+/*!
+ * \brief stand-in for a large set of items while they are dragged
+ * The dragged items are made invisible (but stay selected and indexed)
+ * and are painted by this single item instead. Moving the preview touches
+ * the scene index only once per move, regardless of the number of items.
+ */
+class DragPreviewItem : public QGraphicsItem
+{
+public:
+    enum { Type = UserType + 40 };
+    // number of dragged items from which on the preview is used
+    static const int threshold = 200;
+
+    explicit DragPreviewItem(const QList<QGraphicsItem*> &items);
+
+    QList<QGraphicsItem*> items() const { return m_items; }
+    void restore();
+
+    QRectF boundingRect() const override;
+    void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+               QWidget *widget = nullptr) override;
+    int type() const override { return Type; }
+
+private:
+    void paintItem(QGraphicsItem *item, QPainter *painter,
+                   const QStyleOptionGraphicsItem *option, QWidget *widget);
+
+    QList<QGraphicsItem*> m_items;
+    QVector<qreal> m_opacities;
+    QRectF m_rect;
+};
+
+#endif // DRAGPREVIEWITEM_H
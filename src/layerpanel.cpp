@@ -0,0 +1,143 @@
+#include "layerpanel.h"
+#include "diagramscene.h"
+
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QInputDialog>
+#include <QPushButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+LayerPanel::LayerPanel(DiagramScene *scene, QWidget *parent)
+    : QWidget(parent), m_scene(scene)
+{
+    m_refreshing=false;
+    m_tree=new QTreeWidget(this);
+    m_tree->setRootIsDecorated(false);
+    m_tree->setHeaderLabels({tr("Layer"),tr("Visible"),tr("Locked")});
+    m_tree->header()->setStretchLastSection(false);
+    m_tree->header()->setSectionResizeMode(NameColumn,QHeaderView::Stretch);
+    m_tree->header()->setSectionResizeMode(VisibleColumn,QHeaderView::ResizeToContents);
+    m_tree->header()->setSectionResizeMode(LockedColumn,QHeaderView::ResizeToContents);
+    connect(m_tree,&QTreeWidget::itemChanged,this,&LayerPanel::itemChanged);
+    connect(m_tree,&QTreeWidget::itemDoubleClicked,this,&LayerPanel::itemDoubleClicked);
+    connect(m_tree,&QTreeWidget::itemSelectionChanged,this,&LayerPanel::updateButtons);
+
+    QPushButton *addButton=new QPushButton(tr("Add"),this);
+    connect(addButton,&QPushButton::clicked,this,&LayerPanel::addLayer);
+    m_removeButton=new QPushButton(tr("Remove"),this);
+    connect(m_removeButton,&QPushButton::clicked,this,&LayerPanel::removeLayer);
+    m_moveButton=new QPushButton(tr("Move Selection"),this);
+    m_moveButton->setToolTip(tr("Move selected items to this layer"));
+    connect(m_moveButton,&QPushButton::clicked,this,&LayerPanel::moveSelection);
+
+    QHBoxLayout *buttons=new QHBoxLayout;
+    buttons->addWidget(addButton);
+    buttons->addWidget(m_removeButton);
+    buttons->addWidget(m_moveButton);
+    QVBoxLayout *layout=new QVBoxLayout(this);
+    layout->setContentsMargins(0,0,0,0);
+    layout->addWidget(m_tree);
+    layout->addLayout(buttons);
+
+    // layers may change while items are added, refresh once afterwards
+    connect(m_scene,&DiagramScene::layersChanged,this,&LayerPanel::refresh,Qt::QueuedConnection);
+    refresh();
+}
+/*!
+ * \brief rebuild list from scene
+ */
+void LayerPanel::refresh()
+{
+    const QString selected=selectedLayer();
+    m_refreshing=true;
+    m_tree->clear();
+    for(const QString &name:m_scene->layers()){
+        QTreeWidgetItem *item=new QTreeWidgetItem(m_tree);
+        item->setData(NameColumn,Qt::UserRole,name);
+        item->setText(NameColumn,name.isEmpty() ? tr("Default") : name);
+        item->setCheckState(VisibleColumn,m_scene->isLayerVisible(name) ? Qt::Checked : Qt::Unchecked);
+        item->setCheckState(LockedColumn,m_scene->isLayerLocked(name) ? Qt::Checked : Qt::Unchecked);
+        if(name.isEmpty()){
+            // default layer is always visible and unlocked
+            item->setFlags(item->flags()&~Qt::ItemIsUserCheckable);
+        }
+        if(name==m_scene->currentLayer()){
+            QFont f=item->font(NameColumn);
+            f.setBold(true);
+            item->setFont(NameColumn,f);
+        }
+        if(name==selected){
+            m_tree->setCurrentItem(item);
+        }
+    }
+    m_refreshing=false;
+    updateButtons();
+}
+
+void LayerPanel::itemChanged(QTreeWidgetItem *item, int column)
+{
+    if(m_refreshing){
+        return;
+    }
+    const QString name=item->data(NameColumn,Qt::UserRole).toString();
+    const bool checked=item->checkState(column)==Qt::Checked;
+    switch (column) {
+    case VisibleColumn:
+        m_scene->setLayerVisible(name,checked);
+        break;
+    case LockedColumn:
+        m_scene->setLayerLocked(name,checked);
+        break;
+    default:
+        break;
+    }
+}
+
+void LayerPanel::itemDoubleClicked(QTreeWidgetItem *item)
+{
+    m_scene->setCurrentLayer(item->data(NameColumn,Qt::UserRole).toString());
+}
+
+void LayerPanel::addLayer()
+{
+    bool ok;
+    const QString name=QInputDialog::getText(this,tr("Add Layer"),tr("Name:"),QLineEdit::Normal,QString(),&ok).trimmed();
+    if(!ok || name.isEmpty()){
+        return;
+    }
+    m_scene->setCurrentLayer(name);
+}
+/*!
+ * \brief remove selected layer, its items go to the default layer
+ */
+void LayerPanel::removeLayer()
+{
+    const QString name=selectedLayer();
+    if(name.isEmpty()){
+        return;
+    }
+    m_scene->removeLayer(name);
+    m_scene->takeSnapshot();
+}
+
+void LayerPanel::moveSelection()
+{
+    if(!m_tree->currentItem()){
+        return;
+    }
+    m_scene->moveToLayer(m_scene->selection(),selectedLayer());
+    m_scene->takeSnapshot();
+}
+
+void LayerPanel::updateButtons()
+{
+    m_removeButton->setEnabled(!selectedLayer().isEmpty());
+    m_moveButton->setEnabled(m_tree->currentItem()!=nullptr);
+}
+
+QString LayerPanel::selectedLayer() const
+{
+    QTreeWidgetItem *item=m_tree->currentItem();
+    return item ? item->data(NameColumn,Qt::UserRole).toString() : QString();
+}
@@ -0,0 +1,44 @@
+#ifndef LAYERPANEL_H
+#define LAYERPANEL_H
+
+#include <QWidget>
+
+class DiagramScene;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+/*!
+ * \brief list of the layers of a scene
+ * Layers can be shown/hidden and locked with the check boxes, a double click
+ * makes a layer current, i.e. new items are put there.
+ */
+class LayerPanel : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LayerPanel(DiagramScene *scene, QWidget *parent = nullptr);
+
+private slots:
+    void refresh();
+    void itemChanged(QTreeWidgetItem *item, int column);
+    void itemDoubleClicked(QTreeWidgetItem *item);
+    void addLayer();
+    void removeLayer();
+    void moveSelection();
+    void updateButtons();
+
+private:
+    enum Column { NameColumn, VisibleColumn, LockedColumn };
+
+    QString selectedLayer() const;
+
+    DiagramScene *m_scene;
+    QTreeWidget *m_tree;
+    QPushButton *m_removeButton;
+    QPushButton *m_moveButton;
+    bool m_refreshing;
+};
+
+#endif // LAYERPANEL_H
@@ -0,0 +1,92 @@
+#include "librarybrowser.h"
+#include "librarymodel.h"
+
+#include <QLineEdit>
+#include <QListView>
+#include <QVBoxLayout>
+
+LibraryBrowser::LibraryBrowser(QWidget *parent)
+    : QWidget(parent)
+{
+    m_model=new LibraryModel(this);
+    m_filter=new LibraryFilterModel(this);
+    m_filter->setSourceModel(m_model);
+    m_filter->sort(0);
+
+    m_search=new QLineEdit(this);
+    m_search->setPlaceholderText(tr("Search elements"));
+    m_search->setClearButtonEnabled(true);
+    connect(m_search,&QLineEdit::textChanged,this,&LibraryBrowser::search);
+    connect(m_search,&QLineEdit::returnPressed,this,&LibraryBrowser::pickFirst);
+
+    m_view=new QListView(this);
+    m_view->setModel(m_filter);
+    m_view->setViewMode(QListView::IconMode);
+    m_view->setMovement(QListView::Static);
+    m_view->setResizeMode(QListView::Adjust);
+    m_view->setIconSize(QSize(50,50));
+    m_view->setGridSize(QSize(90,90));
+    m_view->setWordWrap(true);
+    m_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    // no size query per row, layout in batches
+    m_view->setUniformItemSizes(true);
+    m_view->setLayoutMode(QListView::Batched);
+    m_view->setBatchSize(200);
+    connect(m_view,&QListView::clicked,this,&LibraryBrowser::select);
+    connect(m_view,&QListView::activated,this,&LibraryBrowser::select);
+
+    QVBoxLayout *layout=new QVBoxLayout(this);
+    layout->setContentsMargins(0,0,0,0);
+    layout->addWidget(m_search);
+    layout->addWidget(m_view);
+
+    // rescore after the library was (re)read or single files changed,
+    // the list stays where the user scrolled to
+    auto rescore=[this](){
+        m_filter->setQuery(m_search->text());
+    };
+    connect(m_model,&LibraryModel::scanned,this,rescore);
+    connect(m_model,&QAbstractItemModel::rowsInserted,this,rescore);
+    connect(m_model,&QAbstractItemModel::rowsRemoved,this,rescore);
+    connect(m_model,&LibraryModel::elementChanged,this,rescore);
+    connect(m_model,&LibraryModel::elementChanged,this,&LibraryBrowser::elementChanged);
+}
+/*!
+ * \brief read elements of directories
+ * \param directories
+ */
+void LibraryBrowser::setDirectories(const QStringList &directories)
+{
+    m_model->scan(directories);
+}
+
+void LibraryBrowser::clearSelection()
+{
+    m_view->clearSelection();
+    m_view->setCurrentIndex(QModelIndex());
+}
+
+void LibraryBrowser::search(const QString &text)
+{
+    m_filter->setQuery(text);
+    m_view->scrollToTop();
+}
+
+void LibraryBrowser::pickFirst()
+{
+    const QModelIndex index=m_filter->index(0,0);
+    if(index.isValid()){
+        m_view->setCurrentIndex(index);
+        select(index);
+    }
+}
+
+void LibraryBrowser::select(const QModelIndex &index)
+{
+    if(!index.isValid()){
+        return;
+    }
+    const QString fileName=index.data(LibraryModel::FileNameRole).toString();
+    const bool userElement=index.data(LibraryModel::KindRole).toInt()==ThumbnailLoader::UserElement;
+    emit elementSelected(fileName,userElement);
+}
@@ -0,0 +1,43 @@
+#ifndef LIBRARYBROWSER_H
+#define LIBRARYBROWSER_H
+
+#include <QWidget>
+
+class LibraryFilterModel;
+class LibraryModel;
+class QLineEdit;
+class QListView;
+class QModelIndex;
+
+/*!
+ * \brief searchable list of all library and user elements
+ * The list view only creates icons for visible rows, so the library size
+ * does not matter. Typing filters, Enter picks the best match.
+ */
+class LibraryBrowser : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryBrowser(QWidget *parent = nullptr);
+
+    void setDirectories(const QStringList &directories);
+    void clearSelection();
+
+signals:
+    void elementSelected(const QString &fileName, bool userElement);
+    void elementChanged(const QString &fileName);
+
+private slots:
+    void search(const QString &text);
+    void pickFirst();
+    void select(const QModelIndex &index);
+
+private:
+    QLineEdit *m_search;
+    QListView *m_view;
+    LibraryModel *m_model;
+    LibraryFilterModel *m_filter;
+};
+
+#endif // LIBRARYBROWSER_H
@@ -0,0 +1,474 @@
+#include "librarymodel.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <algorithm>
+
+LibraryModel::LibraryModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+    m_thumbnails=new ThumbnailLoader(this);
+    connect(m_thumbnails,&ThumbnailLoader::thumbnailReady,this,&LibraryModel::thumbnailReady);
+    connect(&m_scan,&QFutureWatcher<ScanResult>::finished,this,&LibraryModel::scanFinished);
+    m_watcher=new QFileSystemWatcher(this);
+    connect(m_watcher,&QFileSystemWatcher::fileChanged,this,&LibraryModel::fileChanged);
+    connect(m_watcher,&QFileSystemWatcher::directoryChanged,this,&LibraryModel::directoryChanged);
+}
+
+LibraryModel::~LibraryModel()
+{
+    m_scan.waitForFinished();
+}
+
+int LibraryModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_entries.size();
+}
+
+QVariant LibraryModel::data(const QModelIndex &index, int role) const
+{
+    if(!index.isValid() || index.row()>=m_entries.size()){
+        return QVariant();
+    }
+    const Entry &e=m_entries.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        return e.name;
+    case Qt::ToolTipRole:
+        return e.tags.isEmpty() ? e.category : e.category+": "+e.tags.join(", ");
+    case Qt::DecorationRole:
+    {
+        auto it=m_icons.constFind(e.fileName);
+        if(it!=m_icons.constEnd()){
+            return *it;
+        }
+        // only rows which are shown get here
+        if(!m_requested.contains(e.fileName)){
+            m_requested.insert(e.fileName);
+            m_thumbnails->request(e.fileName,e.kind);
+        }
+        return QVariant();
+    }
+    case FileNameRole:
+        return e.fileName;
+    case KindRole:
+        return int(e.kind);
+    case CategoryRole:
+        return e.category;
+    default:
+        return QVariant();
+    }
+}
+/*!
+ * \brief read library directories in the background
+ * scanned() is emitted when the model is updated.
+ * \param directories
+ */
+void LibraryModel::scan(const QStringList &directories)
+{
+    m_scan.setFuture(QtConcurrent::run(&LibraryModel::scanDirectories,directories));
+}
+
+const LibraryModel::Entry &LibraryModel::entry(int row) const
+{
+    return m_entries.at(row);
+}
+/*!
+ * \brief readable name of a library directory
+ * \param directory
+ * \return
+ */
+QString LibraryModel::categoryName(const QString &directory)
+{
+    static const QHash<QString,QString> names{
+        {"analog",tr("Basic Electronic Elements")},
+        {"agates",tr("Analog Blocks")},
+        {"gates",tr("Basic Digital Gates")},
+        {"rf",tr("RF")},
+        {"signal",tr("Signal Processing")},
+        {"userElements",tr("User")}
+    };
+    return names.value(directory,directory);
+}
+/*!
+ * \brief find elements in directories
+ * Runs on a worker thread. Files directly in a directory belong to a
+ * category named after it, files in subdirectories to the subdirectory.
+ * \param directories
+ * \return entries sorted by category and name, and all directories
+ */
+LibraryModel::ScanResult LibraryModel::scanDirectories(const QStringList &directories)
+{
+    ScanResult result;
+    for(const QString &root:directories){
+        const QString directory=QDir::cleanPath(root);
+        if(!QFileInfo(directory).isDir()){
+            continue;
+        }
+        result.directories<<directory;
+        QDirIterator it(directory,{"*.json","*.qdia"},QDir::Files|QDir::AllDirs|QDir::NoDotAndDotDot,
+                        QDirIterator::Subdirectories);
+        while(it.hasNext()){
+            const QFileInfo fi(it.next());
+            if(fi.isDir()){
+                result.directories<<fi.filePath();
+                continue;
+            }
+            Entry e;
+            if(readEntry(fi,e)){
+                result.entries<<e;
+            }
+        }
+    }
+    std::sort(result.entries.begin(),result.entries.end(),entryLess);
+    return result;
+}
+/*!
+ * \brief read name and tags of element file
+ * Elements (*.json) may give "tags", user elements (*.qdia) are named
+ * after their file.
+ * \param fi
+ * \param e
+ * \return false if not readable
+ */
+bool LibraryModel::readEntry(const QFileInfo &fi, Entry &e)
+{
+    e.fileName=fi.filePath();
+    e.category=categoryName(fi.dir().dirName());
+    e.tags.clear();
+    if(fi.suffix()=="qdia"){
+        e.kind=ThumbnailLoader::UserElement;
+        e.name=fi.baseName();
+    }else{
+        e.kind=ThumbnailLoader::Element;
+        QFile file(e.fileName);
+        if(!file.open(QIODevice::ReadOnly)){
+            return false;
+        }
+        const QJsonObject json=QJsonDocument::fromJson(file.readAll()).object();
+        e.name=json["name"].toString(fi.baseName());
+        for(const QJsonValue &tag:json["tags"].toArray()){
+            e.tags<<tag.toString();
+        }
+    }
+    e.key=QStringList({e.name,e.category,e.tags.join(' ')}).join(' ').toLower();
+    return true;
+}
+
+bool LibraryModel::entryLess(const Entry &a, const Entry &b)
+{
+    if(a.category!=b.category){
+        return a.category<b.category;
+    }
+    return a.name.compare(b.name,Qt::CaseInsensitive)<0;
+}
+
+void LibraryModel::scanFinished()
+{
+    const ScanResult result=m_scan.result();
+    beginResetModel();
+    m_entries=result.entries;
+    updateRows();
+    // files may have changed, icons are requested again when shown
+    m_icons.clear();
+    m_requested.clear();
+    endResetModel();
+
+    if(!m_watcher->files().isEmpty()){
+        m_watcher->removePaths(m_watcher->files());
+    }
+    if(!m_watcher->directories().isEmpty()){
+        m_watcher->removePaths(m_watcher->directories());
+    }
+    m_watchedFiles.clear();
+    m_watchedDirectories.clear();
+    QStringList files;
+    for(const Entry &e:m_entries){
+        files<<e.fileName;
+    }
+    watch(result.directories);
+    watch(files);
+    emit scanned();
+}
+/*!
+ * \brief element file was written
+ * \param path
+ */
+void LibraryModel::fileChanged(const QString &path)
+{
+    // the watcher drops files which are removed or replaced
+    m_watchedFiles.remove(path);
+    const QFileInfo fi(path);
+    if(!fi.exists()){
+        // removal is handled with the directory
+        return;
+    }
+    // files replaced by a new one are no longer watched
+    watch({path});
+    const int row=m_rows.value(path,-1);
+    Entry e;
+    if(row>=0 && readEntry(fi,e)){
+        m_entries[row]=e;
+        m_icons.remove(path);
+        m_requested.remove(path);
+        emit dataChanged(index(row),index(row));
+    }
+    emit elementChanged(path);
+}
+/*!
+ * \brief files were added to or removed from a directory
+ * Only the differences are read. New subdirectories are scanned on the
+ * thread pool like the library itself.
+ * \param path
+ */
+void LibraryModel::directoryChanged(const QString &path)
+{
+    const QDir dir(path);
+    for(int row=m_entries.size()-1;row>=0;--row){
+        const QFileInfo fi(m_entries.at(row).fileName);
+        if(fi.path()==path && !fi.exists()){
+            removeEntry(row);
+        }
+    }
+    if(!dir.exists()){
+        return;
+    }
+    QList<Entry> added;
+    QStringList files;
+    for(const QFileInfo &fi:dir.entryInfoList({"*.json","*.qdia"},QDir::Files)){
+        const QString fn=fi.filePath();
+        if(!m_rows.contains(fn)){
+            Entry e;
+            if(readEntry(fi,e)){
+                added<<e;
+                files<<fn;
+            }
+        }else if(!m_watchedFiles.contains(fn)){
+            // replaced by rename
+            fileChanged(fn);
+        }
+    }
+    std::sort(added.begin(),added.end(),entryLess);
+    insertEntries(added);
+    watch(files);
+    // new subdirectories
+    QStringList directories;
+    for(const QFileInfo &fi:dir.entryInfoList(QDir::AllDirs|QDir::NoDotAndDotDot)){
+        if(!m_watchedDirectories.contains(fi.filePath())){
+            directories<<fi.filePath();
+        }
+    }
+    if(directories.isEmpty()){
+        return;
+    }
+    // watched right away, so further changes do not scan them again
+    watch(directories);
+    auto *watcher=new QFutureWatcher<ScanResult>(this);
+    connect(watcher,&QFutureWatcher<ScanResult>::finished,this,[this,watcher](){
+        const ScanResult result=watcher->result();
+        watcher->deleteLater();
+        // a rescan of the library may have been faster
+        QList<Entry> added;
+        QStringList files;
+        for(const Entry &e:result.entries){
+            if(!m_rows.contains(e.fileName)){
+                added<<e;
+                files<<e.fileName;
+            }
+        }
+        insertEntries(added);
+        watch(result.directories);
+        watch(files);
+    });
+    watcher->setFuture(QtConcurrent::run(&LibraryModel::scanDirectories,directories));
+}
+/*!
+ * \brief insert entries into the sorted list
+ * Neighbouring entries are inserted as one range of rows.
+ * \param entries sorted
+ */
+void LibraryModel::insertEntries(const QList<Entry> &entries)
+{
+    int i=0;
+    while(i<entries.size()){
+        auto it=std::lower_bound(m_entries.begin(),m_entries.end(),entries.at(i),entryLess);
+        const int row=int(it-m_entries.begin());
+        int j=i+1;
+        while(j<entries.size() && (row==m_entries.size() || entryLess(entries.at(j),m_entries.at(row)))){
+            ++j;
+        }
+        beginInsertRows(QModelIndex(),row,row+j-i-1);
+        for(int k=i;k<j;++k){
+            m_entries.insert(row+k-i,entries.at(k));
+        }
+        updateRows();
+        endInsertRows();
+        i=j;
+    }
+}
+
+void LibraryModel::removeEntry(int row)
+{
+    beginRemoveRows(QModelIndex(),row,row);
+    const QString fn=m_entries.takeAt(row).fileName;
+    m_icons.remove(fn);
+    m_requested.remove(fn);
+    updateRows();
+    endRemoveRows();
+}
+
+void LibraryModel::updateRows()
+{
+    m_rows.clear();
+    for(int i=0;i<m_entries.size();++i){
+        m_rows.insert(m_entries.at(i).fileName,i);
+    }
+}
+/*!
+ * \brief watch paths on disk, resources cannot change
+ * \param paths
+ */
+void LibraryModel::watch(const QStringList &paths)
+{
+    QStringList lst;
+    for(const QString &path:paths){
+        if(!path.startsWith(':') && !m_watchedFiles.contains(path) && !m_watchedDirectories.contains(path)){
+            lst<<path;
+        }
+    }
+    if(lst.isEmpty()){
+        return;
+    }
+    // QFileSystemWatcher::files() copies its list, lookups use the sets
+    const QStringList failed=m_watcher->addPaths(lst);
+    for(const QString &path:lst){
+        if(failed.contains(path)){
+            continue;
+        }
+        if(QFileInfo(path).isDir()){
+            m_watchedDirectories.insert(path);
+        }else{
+            m_watchedFiles.insert(path);
+        }
+    }
+}
+
+void LibraryModel::thumbnailReady(const QString &fileName, const QImage &image)
+{
+    m_icons.insert(fileName,QIcon(QPixmap::fromImage(image)));
+    const int row=m_rows.value(fileName,-1);
+    if(row>=0){
+        const QModelIndex idx=index(row);
+        emit dataChanged(idx,idx,{Qt::DecorationRole});
+    }
+}
+
+LibraryFilterModel::LibraryFilterModel(QObject *parent)
+    : QSortFilterProxyModel(parent)
+{
+    connect(this,&QSortFilterProxyModel::sourceModelChanged,this,&LibraryFilterModel::updateScores);
+}
+/*!
+ * \brief filter and rank by query
+ * \param query words separated by spaces
+ */
+void LibraryFilterModel::setQuery(const QString &query)
+{
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    m_tokens=query.toLower().split(' ',Qt::SkipEmptyParts);
+#else
+    m_tokens=query.toLower().split(' ',QString::SkipEmptyParts);
+#endif
+    updateScores();
+    invalidate();
+}
+/*!
+ * \brief score of pattern in text, both lower case
+ * Substrings score best, especially at word starts. Otherwise the letters
+ * have to appear in order, runs of letters and word starts add to the score.
+ * \param pattern
+ * \param text
+ * \return score, -1 if not matching
+ */
+int LibraryFilterModel::fuzzyScore(const QString &pattern, const QString &text)
+{
+    const int pos=text.indexOf(pattern);
+    if(pos>=0){
+        int score=100+10*pattern.size();
+        if(pos==0 || !text.at(pos-1).isLetterOrNumber()){
+            score+=50;
+        }
+        return score;
+    }
+    int score=0;
+    int j=0;
+    int last=-2;
+    for(int i=0;i<text.size() && j<pattern.size();++i){
+        if(text.at(i)!=pattern.at(j)){
+            continue;
+        }
+        score+=(i==last+1) ? 5 : 1;
+        if(i==0 || !text.at(i-1).isLetterOrNumber()){
+            score+=3;
+        }
+        last=i;
+        ++j;
+    }
+    return j==pattern.size() ? score : -1;
+}
+
+bool LibraryFilterModel::filterAcceptsRow(int sourceRow, const QModelIndex &) const
+{
+    return m_tokens.isEmpty() || m_scores.value(sourceRow,-1)>=0;
+}
+
+bool LibraryFilterModel::lessThan(const QModelIndex &left, const QModelIndex &right) const
+{
+    if(!m_tokens.isEmpty()){
+        const int l=m_scores.value(left.row());
+        const int r=m_scores.value(right.row());
+        if(l!=r){
+            return l>r;
+        }
+    }
+    // library order
+    return left.row()<right.row();
+}
+/*!
+ * \brief score all entries for current query
+ */
+void LibraryFilterModel::updateScores()
+{
+    auto *model=qobject_cast<LibraryModel*>(sourceModel());
+    m_scores.clear();
+    if(!model || m_tokens.isEmpty()){
+        return;
+    }
+    const int n=model->rowCount();
+    m_scores.resize(n);
+    for(int row=0;row<n;++row){
+        const LibraryModel::Entry &e=model->entry(row);
+        const QString name=e.name.toLower();
+        int total=0;
+        for(const QString &token:m_tokens){
+            int score=fuzzyScore(token,name);
+            if(score>=0){
+                score+=20;
+            }
+            score=qMax(score,fuzzyScore(token,e.key));
+            if(score<0){
+                total=-1;
+                break;
+            }
+            total+=score;
+        }
+        m_scores[row]=total;
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef LIBRARYMODEL_H
+#define LIBRARYMODEL_H
+
+#include "thumbnailloader.h"
+
+#include <QAbstractListModel>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QIcon>
+#include <QSet>
+#include <QSortFilterProxyModel>
+#include <QStringList>
+#include <QVector>
+
+class QFileSystemWatcher;
+
+/*!
+ * \brief elements of the library directories
+ * The directories are scanned on the thread pool. Icons are only requested
+ * when a view asks for them, i.e. for visible rows. Directories on disk are
+ * watched; only added, removed or changed files are read again.
+ */
+class LibraryModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+public:
+    enum Roles { FileNameRole = Qt::UserRole, KindRole, CategoryRole };
+
+    struct Entry
+    {
+        QString fileName;
+        QString name;
+        QString category;
+        QStringList tags;
+        ThumbnailLoader::Kind kind;
+        // lower case name, category and tags for searching
+        QString key;
+    };
+
+    struct ScanResult
+    {
+        QList<Entry> entries;
+        QStringList directories;
+    };
+
+    explicit LibraryModel(QObject *parent = nullptr);
+    ~LibraryModel() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    void scan(const QStringList &directories);
+    const Entry &entry(int row) const;
+
+    static QString categoryName(const QString &directory);
+    static ScanResult scanDirectories(const QStringList &directories);
+    static bool readEntry(const QFileInfo &fi, Entry &e);
+    static bool entryLess(const Entry &a, const Entry &b);
+
+signals:
+    void scanned();
+    void elementChanged(const QString &fileName);
+
+private slots:
+    void scanFinished();
+    void thumbnailReady(const QString &fileName, const QImage &image);
+    void fileChanged(const QString &path);
+    void directoryChanged(const QString &path);
+
+private:
+    void insertEntries(const QList<Entry> &entries);
+    void removeEntry(int row);
+    void updateRows();
+    void watch(const QStringList &paths);
+
+    QList<Entry> m_entries;
+    QHash<QString,int> m_rows;
+    ThumbnailLoader *m_thumbnails;
+    mutable QHash<QString,QIcon> m_icons;
+    mutable QSet<QString> m_requested;
+    QFutureWatcher<ScanResult> m_scan;
+    QFileSystemWatcher *m_watcher;
+    QSet<QString> m_watchedFiles;
+    QSet<QString> m_watchedDirectories;
+};
+
+/*!
+ * \brief fuzzy search over the library
+ * All words of the query have to match name, category or tags, either as
+ * substring or as subsequence of letters. Results are ranked by score,
+ * matches in the name count more.
+ */
+class LibraryFilterModel : public QSortFilterProxyModel
+{
+    Q_OBJECT
+
+public:
+    explicit LibraryFilterModel(QObject *parent = nullptr);
+
+    void setQuery(const QString &query);
+    static int fuzzyScore(const QString &pattern, const QString &text);
+
+protected:
+    bool filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const override;
+    bool lessThan(const QModelIndex &left, const QModelIndex &right) const override;
+
+private:
+    void updateScores();
+
+    QStringList m_tokens;
+    // score per source row, -1 if not matching
+    QVector<int> m_scores;
+};
+
+#endif // LIBRARYMODEL_H
@@ -6,6 +6,12 @@
 
 int main(int argc, char *argv[])
 {
+    // replay of recorded sessions runs headless
+    for(int i=1;i<argc;++i){
+        if(qstrcmp(argv[i],"--replay")==0 && !qEnvironmentVariableIsSet("QT_QPA_PLATFORM")){
+            qputenv("QT_QPA_PLATFORM","offscreen");
+        }
+    }
     QApplication a(argc, argv);
 
     QTranslator translator;
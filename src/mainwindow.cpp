@@ -6,12 +6,18 @@
 **
 ****************************************************************************/
 
+#include "autosavejournal.h"
 #include "diagramitem.h"
 #include "diagramscene.h"
 #include "diagramtextitem.h"
 #include "diagramdrawitem.h"
 #include "diagramelement.h"
 #include "diagrampathitem.h"
+#include "diagramview.h"
+#include "layerpanel.h"
+#include "librarybrowser.h"
+#include "minimap.h"
+#include "sessionrecorder.h"
 #include "mainwindow.h"
 #include "config.h"
 
@@ -43,6 +49,7 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent)
     m_lastPathImage=settings.value("lastPathImage").toString();
     QString fontName=settings.value("font").toString();
     int fontSize=settings.value("fontsize").toInt();
+    m_recorder=nullptr;
     // setup GUI
     createActions();
     createToolBox();
@@ -51,8 +58,15 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent)
     currentToolButton=nullptr; // none selected at start
 
     m_scene = new DiagramScene(itemMenu, this);
-    m_scene->setSceneRect(QRectF(0, 0, 5000, 5000));
     m_scene->setGridVisible(configuration.showGrid);
+    m_scene->setEmbedElements(configuration.embedElements);
+    // placed elements follow edits of their library files
+    connect(m_library, &LibraryBrowser::elementChanged,
+            m_scene, &DiagramScene::libraryFileChanged);
+    // unsaved changes are journaled in the background
+    m_journal = new AutosaveJournal(this);
+    connect(m_scene, &DiagramScene::snapshotTaken,
+            m_journal, &AutosaveJournal::record);
     connect(m_scene, &DiagramScene::itemSelected,
             this, &MainWindow::itemSelected);
     connect(m_scene, &DiagramScene::forceCursor,
@@ -74,11 +88,14 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent)
 
     QHBoxLayout *layout = new QHBoxLayout;
     layout->addWidget(toolBox);
-    m_view = new QGraphicsView(m_scene);
+    m_view = new DiagramView(m_scene);
     m_view->setDragMode(QGraphicsView::RubberBandDrag);
     m_view->setCacheMode(QGraphicsView::CacheBackground);
     m_view->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
     m_view->setMouseTracking(true);
+    connect(m_view, &DiagramView::zoomSettled,
+            this, &MainWindow::setGrid);
+    updateRenderMode();
     layout->addWidget(m_view);
 
     QWidget *widget = new QWidget;
@@ -87,6 +104,19 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent)
     setCentralWidget(widget);
     setUnifiedTitleAndToolBarOnMac(true);
 
+    QDockWidget *minimapDock = new QDockWidget(tr("Overview"), this);
+    minimapDock->setObjectName("minimapDock");
+    minimapDock->setWidget(new Minimap(m_view, minimapDock));
+    addDockWidget(Qt::RightDockWidgetArea, minimapDock);
+    viewMenu->addSeparator();
+    viewMenu->addAction(minimapDock->toggleViewAction());
+
+    QDockWidget *layersDock = new QDockWidget(tr("Layers"), this);
+    layersDock->setObjectName("layersDock");
+    layersDock->setWidget(new LayerPanel(m_scene, layersDock));
+    addDockWidget(Qt::RightDockWidgetArea, layersDock);
+    viewMenu->addAction(layersDock->toggleViewAction());
+
     m_view->setFocus();
 
     // update font combo
@@ -99,11 +129,30 @@ MainWindow::MainWindow(int argc, char *argv[], QWidget *parent)
         restoreState(settings.value("windowState").toByteArray());
     }
 
-    if(argc>1){
-        // assume last argument as filename
-        // maybe more elaborate later
-        QString fn=QString(argv[argc-1]);
-        openFile(fn);
+    QList<QAction*> actions=findChildren<QAction*>();
+    actions.removeOne(recordSessionAction);
+    m_recorder=new SessionRecorder(m_view,this);
+    m_recorder->watch(actions,listOfShortcuts);
+
+    // --replay <session> [file]
+    QString fn;
+    for(int i=1;i<argc;++i){
+        const QString arg=QString(argv[i]);
+        if(arg=="--replay"){
+            if(i+1<argc){
+                m_replayFileName=QString(argv[++i]);
+            }else{
+                qWarning("--replay needs a session file");
+            }
+        }else{
+            fn=arg;
+        }
+    }
+    if(fn.isEmpty() || !openFile(fn)){
+        startJournal(QString());
+    }
+    if(!m_replayFileName.isEmpty()){
+        QTimer::singleShot(0,this,&MainWindow::replaySession);
     }
 }
 /*!
@@ -139,6 +188,8 @@ void MainWindow::closeEvent(QCloseEvent *event)
     settings.setValue("fontsize",fontSizeCombo->currentText().toInt());
     settings.setValue("lastPath",m_lastPath);
     settings.setValue("lastPathImage",m_lastPathImage);
+    // keeps unsaved changes for recovery
+    m_journal->stop();
     event->accept();
 }
 
@@ -154,6 +205,7 @@ void MainWindow::buttonGroupClicked(QAbstractButton *button)
             myButton->setChecked(false);
     }
     currentToolButton=button;
+    m_library->clearSelection();
     const int id = buttonGroup->id(button);
     if (id == InsertTextButton) {
         m_scene->setMode(DiagramScene::InsertText);
@@ -163,28 +215,15 @@ void MainWindow::buttonGroupClicked(QAbstractButton *button)
             m_scene->setMode(DiagramScene::InsertDrawItem);
         }
         else {
-            if(id==256){
-                // user element
-                QString fn=button->property("fn").toString();
-                m_scene->setItemType(fn);
-                m_scene->setMode(DiagramScene::InsertUserElement);
-            }else{
-                if(id==128){
-                    QString fn=button->property("fn").toString();
-                    m_scene->setItemType(fn);
-                    m_scene->setMode(DiagramScene::InsertElement);
-                }else{
-                    m_scene->setItemType(DiagramItem::DiagramType(id));
-                    m_scene->setMode(DiagramScene::InsertItem);
-                }
-            }
+            m_scene->setItemType(DiagramItem::DiagramType(id));
+            m_scene->setMode(DiagramScene::InsertItem);
         }
     }
 }
 
 void MainWindow::deleteItem()
 {
-    QList<QGraphicsItem *> selectedItems = m_scene->selectedItems();
+    QList<QGraphicsItem *> selectedItems = m_scene->selection();
 
     for (int i=0;i<selectedItems.length();++i) {
         QGraphicsItem *it=selectedItems[i];
@@ -204,6 +243,7 @@ void MainWindow::pointerGroupClicked(QAbstractButton *button)
         currentToolButton->setChecked(false);
         currentToolButton=nullptr;
     }
+    m_library->clearSelection();
     QList<QAbstractButton *> buttons = pointerTypeGroup->buttons();
     foreach (QAbstractButton *mButton, buttons) {
         if(mButton!=button){
@@ -239,108 +279,40 @@ void MainWindow::vertAlignGroupClicked(QAbstractButton *button)
 
 void MainWindow::bringToFront()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
     m_scene->setCursorVisible(false);
-
-    QGraphicsItem *selectedItem = m_scene->selectedItems().first();
-    const QList<QGraphicsItem *> overlapItems = selectedItem->collidingItems();
-
-    qreal zValue = 0;
-    for (const QGraphicsItem *item : overlapItems) {
-        if (item->zValue() >= zValue)
-            zValue = item->zValue() + 0.1;
-    }
-    selectedItem->setZValue(zValue);
+    m_scene->bringToFront(m_scene->selection());
     m_scene->takeSnapshot();
     m_scene->setCursorVisible(true);
 }
 
 void MainWindow::bringUp()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
     m_scene->setCursorVisible(false);
-
-    QGraphicsItem *selectedItem = m_scene->selectedItems().first();
-    const QList<QGraphicsItem *> overlapItems = selectedItem->collidingItems();
-
-    qreal zValue=selectedItem->zValue();
-    QList<qreal> zValues;
-    for (const QGraphicsItem *item : overlapItems) {
-            zValues << item->zValue();
-    }
-    std::sort(zValues.begin(),zValues.end());
-    int i=0;
-    bool found=false;
-    for(;i<zValues.size();++i) {
-        qreal z=zValues.at(i);
-        if(z<=zValue) continue;
-        zValue=z;
-        found=true;
-        break;
-    }
-    if( (i+1)<zValues.size()){
-        // make sure that it is above one but not the next higher one
-        zValue=(zValue+zValues[i+1])/2;
-    }else{
-        if(found) zValue+=0.1;
-    }
-    m_scene->setMaxZ(zValue);
-    selectedItem->setZValue(zValue);
+    m_scene->bringUp(m_scene->selection());
     m_scene->takeSnapshot();
     m_scene->setCursorVisible(true);
 }
 
 void MainWindow::sendToBack()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
     m_scene->setCursorVisible(false);
-    QGraphicsItem *selectedItem = m_scene->selectedItems().first();
-    const QList<QGraphicsItem *> overlapItems = selectedItem->collidingItems();
-
-    qreal zValue = 0;
-    for (const QGraphicsItem *item : overlapItems) {
-        if (item->zValue() <= zValue)
-            zValue = item->zValue() - 0.1;
-    }
-    selectedItem->setZValue(zValue);
+    m_scene->sendToBack(m_scene->selection());
     m_scene->takeSnapshot();
     m_scene->setCursorVisible(true);
 }
 
 void MainWindow::sendDown()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
     m_scene->setCursorVisible(false);
-
-    QGraphicsItem *selectedItem = m_scene->selectedItems().first();
-    const QList<QGraphicsItem *> overlapItems = selectedItem->collidingItems();
-
-    qreal zValue=selectedItem->zValue();
-    QList<qreal> zValues;
-    for (const QGraphicsItem *item : overlapItems) {
-            zValues << item->zValue();
-    }
-    std::sort(zValues.begin(),zValues.end());
-    bool found=false;
-    int i=zValues.size()-1;
-    for(;i>=0;--i) {
-        qreal z=zValues[i];
-        if(z>zValue) continue;
-        found=true;
-        zValue=z;
-        break;
-    }
-    if( (i-1)>=0){
-        // make sure that it is above one but not the next higher one
-        zValue=(zValue+zValues[i-1])/2;
-    }else{
-        if(found) zValue-=0.1;
-    }
-    selectedItem->setZValue(zValue);
+    m_scene->sendDown(m_scene->selection());
     m_scene->takeSnapshot();
     m_scene->setCursorVisible(true);
 }
@@ -350,9 +322,7 @@ void MainWindow::sendDown()
  */
 void MainWindow::selectAll()
 {
-    for(auto *item:m_scene->items()){
-        item->setSelected(true);
-    }
+    m_scene->selectAllItems();
 }
 
 void MainWindow::rotateRight()
@@ -477,7 +447,7 @@ void MainWindow::itemSelected(QGraphicsItem *item)
     DiagramTextItem *textItem =
     qgraphicsitem_cast<DiagramTextItem *>(item);
 
-    QList<QGraphicsItem*> lst=m_scene->selectedItems();
+    QList<QGraphicsItem*> lst=m_scene->selection();
     if(lst.size()>1){
         // only change text control for single element
         return;
@@ -564,136 +534,45 @@ void MainWindow::createToolBox()
 
     toolBox->addItem(itemWidget, tr("Basic Shapes"));
 
-    QStringList paths,names;
-    QList<QStringList> lstOfElements;
-    paths<<":/libs/analog/";
-    names<<tr("Basic Electronic Elements");
-    lstOfElements<<QStringList{
-                   "circle.json",
-                   "arrow.json",
-                   "dot.json",
-                   "res.json",
-                   "cap.json",
-                   "ind.json",
-                   "nmos.json",
-                   "pmos.json",
-                   "diode.json",
-                   "led.json",
-                   "pd.json",
-                   "vsource.json",
-                   "isource.json",
-                   "acsource.json",
-                   "gnd.json",
-                   "vdd.json",
-                   "switch_open.json",
-                   "switch_closed.json",
-                   "switch_2t.json"
-    };
-    paths<<":/libs/agates/";
-    names<<tr("Analog Blocks");
-    lstOfElements<<QStringList{
-                   "ota.json"
-    };
-    paths<<":/libs/gates/";
-    names<<tr("Basic Digital Gates");
-    lstOfElements<<QStringList{
-                   "and.json",
-                   "nand.json",
-                   "or.json",
-                   "nor.json",
-                   "xor.json",
-                   "xnor.json",
-                   "buffer.json",
-                   "inverter.json",
-                   "dff.json",
-                   "not.json"
-    };
-    paths<<":/libs/rf/";
-    names<<tr("RF");
-    lstOfElements<<QStringList{
-                   "mixer.json",
-                   "lpf.json",
-                   "bpf.json",
-                   "hpf.json"
-    };
-    paths<<":/libs/signal/";
-    names<<tr("Signal Processing");
-    lstOfElements<<QStringList{
-                   "add.json",
-                   "subtract.json",
-                   "mult.json",
-                   "div.json",
-                   "limit.json"
-    };
-
-    for(int i=0;i<paths.size();++i){
-        bG = new QButtonGroup(this);
-        bG->setExclusive(false);
-        connect(bG, QOverload<QAbstractButton *>::of(&QButtonGroup::buttonClicked),
-                this, &MainWindow::buttonGroupClicked);
-        layout = new QGridLayout;
-        // added DrawItem
-        QString path=paths.value(i);
-
-        row=0;
-        col=0;
-        for (const QString &fn: lstOfElements.value(i)) {
-            QWidget *bt=createCellWidget(path+fn,128,bG);
-            layout->addWidget(bt, row, col);
-            ++col;
-            if(col>2){
-                col=0;
-                ++row;
-            }
-        }
-        if(col>0) ++row;
-
-        layout->setRowStretch(row, 10);
-        layout->setColumnStretch(2, 10);
-
-        itemWidget = new QWidget;
-        itemWidget->setLayout(layout);
-
-        toolBox->addItem(itemWidget, names.value(i));
-    }
-    // add user pane !
+    // library and user elements
+    m_library = new LibraryBrowser;
+    connect(m_library, &LibraryBrowser::elementSelected,
+            this, &MainWindow::libraryElementSelected);
+    m_library->setDirectories(libraryDirectories());
+    toolBox->addItem(m_library, tr("Elements"));
+}
+/*!
+ * \brief directories shown in the element library
+ * Built-in elements, user elements and the configured library paths.
+ * \return
+ */
+QStringList MainWindow::libraryDirectories() const
+{
 #ifdef Q_OS_WIN
     const QString elementPath="%appdata%/.config/QDia/userElements";
    #else
     const QString elementPath=QDir::homePath()+"/.config/QDia/userElements/";
 #endif
-    QDir dir(elementPath);
-    QStringList userElements=dir.entryList({"*.qdia"},QDir::Files);
-    if(!userElements.isEmpty()){
-        // add pane and fill
-        bG = new QButtonGroup(this);
-        bG->setExclusive(false);
-        connect(bG, QOverload<QAbstractButton *>::of(&QButtonGroup::buttonClicked),
-                this, &MainWindow::buttonGroupClicked);
-        layout = new QGridLayout;
-        // added DrawItem
-        row=0;
-        col=0;
-        for (const QString &fn: userElements) {
-            QWidget *bt=createCellWidget(elementPath+fn,256,bG);
-            if(!bt) continue; // skip invalid entries
-            layout->addWidget(bt, row, col);
-            ++col;
-            if(col>2){
-                col=0;
-                ++row;
-            }
-        }
-        if(col>0) ++row;
-
-        layout->setRowStretch(row, 10);
-        layout->setColumnStretch(2, 10);
-
-        itemWidget = new QWidget;
-        itemWidget->setLayout(layout);
-
-        toolBox->addItem(itemWidget, "user");
+    QStringList result({":/libs", elementPath});
+    result<<configuration.libraryPaths;
+    return result;
+}
+/*!
+ * \brief insert element picked in library
+ * \param fileName
+ * \param userElement
+ */
+void MainWindow::libraryElementSelected(const QString &fileName, bool userElement)
+{
+    for (QAbstractButton *button : pointerTypeGroup->buttons()) {
+        button->setChecked(false);
+    }
+    if(currentToolButton){
+        currentToolButton->setChecked(false);
+        currentToolButton=nullptr;
     }
+    m_scene->setItemType(fileName);
+    m_scene->setMode(userElement ? DiagramScene::InsertUserElement : DiagramScene::InsertElement);
 }
 
 void MainWindow::createActions()
@@ -824,6 +703,11 @@ void MainWindow::createActions()
     connect(tapAction,&QAction::triggered,this,&MainWindow::tapItem);
     listOfActions.append(tapAction);
 
+    elementParametersAction = new QAction(tr("Element &Parameters..."), this);
+    elementParametersAction->setStatusTip(tr("Change parameters of selected elements, e.g. number of inputs"));
+    connect(elementParametersAction,&QAction::triggered,this,&MainWindow::editElementParameters);
+    listOfActions.append(elementParametersAction);
+
     moveAction = new QAction(QIcon(":/images/transform-move.svg"),tr("&Move"), this);
     moveAction->setShortcut(tr("m"));
     connect(moveAction, &QAction::triggered, this, &MainWindow::moveItems);
@@ -911,6 +795,46 @@ void MainWindow::createActions()
             this, &MainWindow::toggleGrid);
     listOfActions.append(showGridAction);
 
+    showHudAction = new QAction(tr("Performance &HUD"), this);
+    showHudAction->setShortcut(tr("F12"));
+    showHudAction->setCheckable(true);
+    showHudAction->setStatusTip(tr("Show frame time and paint cost overlay"));
+    connect(showHudAction, &QAction::toggled,
+            this, &MainWindow::toggleHud);
+    listOfActions.append(showHudAction);
+
+    tiledRenderingAction = new QAction(tr("&Tiled Rendering"), this);
+    tiledRenderingAction->setCheckable(true);
+    tiledRenderingAction->setChecked(configuration.tiledRendering);
+    tiledRenderingAction->setStatusTip(tr("Keep rendered tiles for smooth pan and zoom"));
+    connect(tiledRenderingAction, &QAction::toggled,
+            this, &MainWindow::toggleTiledRendering);
+
+    parallelRenderingAction = new QAction(tr("&Parallel Rendering"), this);
+    parallelRenderingAction->setCheckable(true);
+    parallelRenderingAction->setChecked(configuration.parallelRendering);
+    parallelRenderingAction->setStatusTip(tr("Rasterize tiles on all cores, implies tiled rendering"));
+    connect(parallelRenderingAction, &QAction::toggled,
+            this, &MainWindow::toggleParallelRendering);
+
+    embedElementsAction = new QAction(tr("&Embed Element Definitions"), this);
+    embedElementsAction->setCheckable(true);
+    embedElementsAction->setChecked(configuration.embedElements);
+    embedElementsAction->setStatusTip(tr("Save used elements with the document, so it does not depend on the library"));
+    connect(embedElementsAction, &QAction::toggled,
+            this, &MainWindow::toggleEmbedElements);
+
+    libraryPathsAction = new QAction(tr("Library &Directories..."), this);
+    libraryPathsAction->setStatusTip(tr("Set additional directories of the element library"));
+    connect(libraryPathsAction, &QAction::triggered,
+            this, &MainWindow::editLibraryPaths);
+
+    recordSessionAction = new QAction(tr("&Record Input Session..."), this);
+    recordSessionAction->setCheckable(true);
+    recordSessionAction->setStatusTip(tr("Record mouse/keyboard input for replay with --replay"));
+    connect(recordSessionAction, &QAction::toggled,
+            this, &MainWindow::toggleRecording);
+
     loadAction = new QAction(QIcon(":/images/document-open.svg"),tr("&Open ..."), this);
     loadAction->setShortcut(tr("Ctrl+o"));
     connect(loadAction, &QAction::triggered,
@@ -939,6 +863,33 @@ void MainWindow::createActions()
     connect(pasteFromClipboardAction,&QAction::triggered,
             this, &MainWindow::pasteFromClipboard);
     listOfActions.append(pasteFromClipboardAction);
+
+    // recorded sessions refer to actions by name, independent of the translation
+    const QList<QPair<QAction*,QString>> names={
+        {undoAction,"undo"}, {redoAction,"redo"}, {toFrontAction,"toFront"},
+        {sendBackAction,"sendBack"}, {bringUpAction,"bringUp"}, {sendDownAction,"sendDown"},
+        {rotateRightAction,"rotateRight"}, {rotateLeftAction,"rotateLeft"},
+        {groupAction,"group"}, {ungroupAction,"ungroup"}, {makeElementAction,"makeElement"},
+        {deleteAction,"delete"}, {exitAction,"exit"}, {selectAllAction,"selectAll"},
+        {boldAction,"bold"}, {italicAction,"italic"}, {underlineAction,"underline"},
+        {aboutAction,"about"}, {printAction,"print"}, {exportAction,"export"},
+        {copyAction,"copy"}, {duplicateAction,"duplicate"}, {tapAction,"tap"},
+        {elementParametersAction,"elementParameters"}, {moveAction,"move"},
+        {flipXAction,"flipX"}, {flipYAction,"flipY"}, {dotAction,"dot"}, {lineAction,"line"},
+        {rectAction,"rect"}, {textAction,"text"}, {zoomInAction,"zoomIn"},
+        {zoomOutAction,"zoomOut"}, {zoomAction,"zoom"}, {zoomFitAction,"zoomFit"},
+        {finerGridAction,"finerGrid"}, {coarserGridAction,"coarserGrid"},
+        {showGridAction,"showGrid"}, {showHudAction,"showHud"},
+        {tiledRenderingAction,"tiledRendering"},
+        {parallelRenderingAction,"parallelRendering"}, {embedElementsAction,"embedElements"},
+        {libraryPathsAction,"libraryPaths"}, {recordSessionAction,"recordSession"},
+        {loadAction,"load"}, {saveAction,"save"}, {saveAsAction,"saveAs"},
+        {copyToClipboardAction,"copyToClipboard"},
+        {pasteFromClipboardAction,"pasteFromClipboard"}
+    };
+    for(const auto &name:names){
+        name.first->setObjectName(name.second);
+    }
 }
 
 void MainWindow::createMenus()
@@ -951,6 +902,8 @@ void MainWindow::createMenus()
     fileMenu->addMenu(m_recentFilesMenu);
     fileMenu->addAction(saveAction);
     fileMenu->addAction(saveAsAction);
+    fileMenu->addAction(embedElementsAction);
+    fileMenu->addAction(libraryPathsAction);
     fileMenu->addAction(copyToClipboardAction);
     fileMenu->addAction(pasteFromClipboardAction);
     fileMenu->addAction(printAction);
@@ -967,6 +920,10 @@ void MainWindow::createMenus()
     viewMenu->addAction(coarserGridAction);
     viewMenu->addSeparator();
     viewMenu->addAction(showGridAction);
+    viewMenu->addAction(showHudAction);
+    viewMenu->addAction(tiledRenderingAction);
+    viewMenu->addAction(parallelRenderingAction);
+    viewMenu->addAction(recordSessionAction);
 
     createMenu = menuBar()->addMenu(tr("&Create"));
     createMenu->addAction(dotAction);
@@ -997,6 +954,7 @@ void MainWindow::createMenus()
     itemMenu->addAction(groupAction);
     itemMenu->addAction(ungroupAction);
     itemMenu->addAction(tapAction);
+    itemMenu->addAction(elementParametersAction);
     itemMenu->addAction(makeElementAction);
 
     aboutMenu = menuBar()->addMenu(tr("&Help"));
@@ -1187,15 +1145,48 @@ void MainWindow::createToolbars()
 }
 /*!
  * \brief populate RecentFiles menu
+ * Previews are taken from the document headers, the items are not read.
  */
 void MainWindow::populateRecentFiles()
 {
     m_recentFilesMenu->clear();
+    m_recentFilesMenu->setToolTipsVisible(true);
     for(const QString &elem:m_recentFiles){
-        QAction *act=new QAction(elem);
+        // owned by the menu, so it is deleted by clear() and found for replays
+        QAction *act=new QAction(elem,m_recentFilesMenu);
+        act->setObjectName("recentFile:"+elem);
+        const QJsonObject header=DiagramScene::readHeader(elem);
+        if(!header.isEmpty()){
+            const QImage preview=DiagramScene::headerPreview(header);
+            if(!preview.isNull()){
+                act->setIcon(QIcon(QPixmap::fromImage(preview)));
+            }
+            act->setToolTip(documentSummary(header));
+        }
         connect(act,&QAction::triggered,this,&MainWindow::openRecentFile);
         m_recentFilesMenu->addAction(act);
+        if(m_recorder){
+            m_recorder->watch({act},{});
+        }
+    }
+}
+/*!
+ * \brief short description of document from its header
+ * \param header
+ * \return
+ */
+QString MainWindow::documentSummary(const QJsonObject &header) const
+{
+    const QJsonArray bounds=header["bounds"].toArray();
+    QString text=tr("%n item(s)","",header["items"].toInt());
+    if(bounds.size()==4){
+        text+=tr(", %1 x %2").arg(bounds[2].toDouble(),0,'f',0).arg(bounds[3].toDouble(),0,'f',0);
+    }
+    const QJsonArray files=header["elementFiles"].toArray();
+    if(!files.isEmpty()){
+        text+=tr(", %n element type(s)","",files.size());
     }
+    return text;
 }
 
 QWidget *MainWindow::createCellWidget(const QString &text,
@@ -1203,47 +1194,16 @@ QWidget *MainWindow::createCellWidget(const QString &text,
 {
     QToolButton *button = new QToolButton;
     QString name=text;
-    if(type==128){
-        DiagramElement item(text, itemMenu);
+    if(type>63){
+        DiagramDrawItem item(static_cast<DiagramDrawItem::DiagramType>(type-64), itemMenu);
+        item.setPos2(230,230);
+        item.setEndPoint(QPointF(-1,2));
         QIcon icon(item.image());
         button->setIcon(icon);
-        button->setProperty("fn",text);
-        name=item.getName();
     }else{
-        if(type==256){
-            auto *virtScene = new DiagramScene(itemMenu, this);
-            virtScene->setSceneRect(QRectF(0, 0, 5000, 5000));
-            virtScene->setGridVisible(false);
-            virtScene->setCursorVisible(false);
-            QFile file(text);
-            if (!file.open(QIODevice::ReadOnly | QIODevice::Text)){
-                return nullptr;
-            }
-            virtScene->load_json(&file);
-            QRectF rect=virtScene->itemsBoundingRect(); // Bonding der Elemente in scene
-            QRectF target(0,0,250,250);
-
-            QPixmap pixmap(250, 250);
-            pixmap.fill(Qt::transparent);
-            QPainter painter(&pixmap);
-            virtScene->render(&painter,target,rect);
-            button->setIcon(pixmap);
-            button->setProperty("fn",text);
-            QFileInfo fi(text);
-            name=fi.baseName();
-        }else{
-            if(type>63){
-                DiagramDrawItem item(static_cast<DiagramDrawItem::DiagramType>(type-64), itemMenu);
-                item.setPos2(230,230);
-                item.setEndPoint(QPointF(-1,2));
-                QIcon icon(item.image());
-                button->setIcon(icon);
-            }else{
-                DiagramItem item(static_cast<DiagramItem::DiagramType>(type), itemMenu);
-                QIcon icon(item.image());
-                button->setIcon(icon);
-            }
-        }
+        DiagramItem item(static_cast<DiagramItem::DiagramType>(type), itemMenu);
+        QIcon icon(item.image());
+        button->setIcon(icon);
     }
     button->setIconSize(QSize(50, 50));
     button->setCheckable(true);
@@ -1259,6 +1219,18 @@ QWidget *MainWindow::createCellWidget(const QString &text,
     return widget;
 }
 
+/*!
+ * \brief stable name of a menu entry for recorded sessions
+ * The same menus are built for several slots, the slot tells them apart.
+ * \param slot as given by SLOT()
+ * \param i index of entry
+ * \return
+ */
+static QString menuActionName(const char *slot, int i)
+{
+    return QString("%1:%2").arg(QString::fromLatin1(slot+1).section('(',0,0)).arg(i);
+}
+
 QMenu *MainWindow::createColorMenu(const char *slot, QColor defaultColor)
 {
     QList<QColor> colors;
@@ -1270,6 +1242,7 @@ QMenu *MainWindow::createColorMenu(const char *slot, QColor defaultColor)
     QMenu *colorMenu = new QMenu(this);
     for (int i = 0; i < colors.count(); ++i) {
         QAction *action = new QAction(names.at(i), this);
+        action->setObjectName(menuActionName(slot,i));
         action->setData(colors.at(i));
         action->setIcon(createColorIcon(colors.at(i)));
         connect(action, SIGNAL(triggered()), this, slot);
@@ -1332,7 +1305,7 @@ void MainWindow::copyToClipboard()
     bool gridVisible=m_scene->isGridVisible();
     m_scene->setGridVisible(false);
     QClipboard *clipboard = QGuiApplication::clipboard();
-    QRectF rect=m_scene->itemsBoundingRect();
+    QRectF rect=m_scene->contentBounds();
     rect.adjust(-1,-1,1,1);
     qreal w=rect.width();
     qreal h=rect.height();
@@ -1365,20 +1338,20 @@ void MainWindow::pasteFromClipboard()
 
 void MainWindow::groupItems()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
 
-    QGraphicsItemGroup *test = m_scene->createItemGroup(m_scene->selectedItems());
+    QGraphicsItemGroup *test = m_scene->createItemGroup(m_scene->selection());
     test->setFlag(QGraphicsItem::ItemIsMovable, true);
     test->setFlag(QGraphicsItem::ItemIsSelectable, true);
 }
 
 void MainWindow::ungroupItems()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
 
-    foreach (QGraphicsItem *item, m_scene->selectedItems()) {
+    foreach (QGraphicsItem *item, m_scene->selection()) {
         if (item->type()==QGraphicsItemGroup::Type) {
             QGraphicsItemGroup *group = qgraphicsitem_cast<QGraphicsItemGroup*>(item);
             group->setSelected(false);
@@ -1396,7 +1369,7 @@ void MainWindow::ungroupItems()
  */
 void MainWindow::makeElement()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
 
     // save selected in special path
@@ -1411,15 +1384,66 @@ void MainWindow::makeElement()
     }
     fileSaveAs(true,elemenPath);
 }
+/*!
+ * \brief edit parameters of selected parametric elements
+ * All selected elements of the same definition get the new values.
+ */
+void MainWindow::editElementParameters()
+{
+    QList<DiagramElement*> elements;
+    for(QGraphicsItem *item:m_scene->selection()){
+        if(item->type()!=DiagramElement::Type)
+            continue;
+        DiagramElement *element=qgraphicsitem_cast<DiagramElement*>(item);
+        if(element->parameterDeclarations().isEmpty())
+            continue;
+        if(elements.isEmpty() || element->getHash()==elements.first()->getHash())
+            elements<<element;
+    }
+    if(elements.isEmpty())
+        return;
+
+    const QJsonObject declarations=elements.first()->parameterDeclarations();
+    QJsonObject values=elements.first()->parameters();
+    for(auto it=declarations.constBegin();it!=declarations.constEnd();++it){
+        const QJsonObject declaration=it.value().toObject();
+        const QString label=declaration["label"].toString(it.key())+":";
+        bool ok;
+        if(declaration["type"].toString("int")=="int"){
+            const int value=QInputDialog::getInt(this, tr("Element Parameters"), label,
+                                                 values[it.key()].toInt(),
+                                                 declaration["min"].toInt(-1000000),
+                                                 declaration["max"].toInt(1000000), 1, &ok);
+            if(!ok)
+                return;
+            values[it.key()]=value;
+        }else{
+            const double value=QInputDialog::getDouble(this, tr("Element Parameters"), label,
+                                                       values[it.key()].toDouble(),
+                                                       declaration["min"].toDouble(-1e6),
+                                                       declaration["max"].toDouble(1e6), 2, &ok);
+            if(!ok)
+                return;
+            values[it.key()]=value;
+        }
+    }
+    bool changed=false;
+    for(DiagramElement *element:elements){
+        changed|=element->setParameters(values);
+    }
+    if(changed){
+        m_scene->takeSnapshot();
+    }
+}
 /*!
  * \brief tap a selected item to extract color/style/pen/etc.
  */
 void MainWindow::tapItem()
 {
-    if (m_scene->selectedItems().isEmpty())
+    if (m_scene->selection().isEmpty())
         return;
 
-    QGraphicsItem *item=m_scene->selectedItems().first();
+    QGraphicsItem *item=m_scene->selection().first();
     if(item->type()==QGraphicsItemGroup::Type) return; // needs to be a single item
     // check text item
     if(item->type()==DiagramTextItem::Type){
@@ -1594,6 +1618,7 @@ void MainWindow::fileExit()
 
     }
     if(canQuit){
+        m_journal->discard();
         qApp->quit();
     }
 }
@@ -1617,7 +1642,7 @@ void MainWindow::exportImage()
     if (!fileName.isEmpty()){
 
         if((selectedFilter=="Pdf (*.pdf)")or(selectedFilter=="Postscript (*.ps)")) {
-            QRectF rect=m_scene->itemsBoundingRect(); // Bonding der Elemente in scene
+            QRectF rect=m_scene->contentBounds(); // Bonding der Elemente in scene
             QPrinter printer;
             printer.setOutputFileName(fileName);
             QRectF size=printer.pageRect(QPrinter::Millimeter); // definiere Paper mit gleichen Aspectratio wie rect
@@ -1629,7 +1654,7 @@ void MainWindow::exportImage()
             m_scene->render(&painter,QRectF(),rect);
         }
         if((selectedFilter=="SVG (*.svg)")) {
-            QRectF rect=m_scene->itemsBoundingRect(); // Bonding der Elemente in scene
+            QRectF rect=m_scene->contentBounds(); // Bonding der Elemente in scene
             QSvgGenerator generator;
             generator.setFileName(fileName);
             generator.setSize(rect.size().toSize());
@@ -1643,7 +1668,7 @@ void MainWindow::exportImage()
             m_scene->render(&painter,target,rect);
         }
         if((selectedFilter=="Png (*.png)")or(selectedFilter=="Jpg (*.jpg)")){
-            QRectF rect=m_scene->itemsBoundingRect(); // Bonding der Elemente in scene
+            QRectF rect=m_scene->contentBounds(); // Bonding der Elemente in scene
             qreal w=rect.width();
             qreal h=rect.height();
             if(w>h){
@@ -1686,35 +1711,23 @@ void MainWindow::zoomOut()
 
 void MainWindow::zoom(const qreal factor)
 {
-    QPointF topLeft     = m_view->mapToScene( 0, 0 );
-    QPointF bottomRight = m_view->mapToScene( m_view->viewport()->width() - 1, m_view->viewport()->height() - 1 );
-    qreal width=bottomRight.x()-topLeft.x();
-    qreal height=bottomRight.y()-topLeft.y();
-    if((width/factor<=5000)&&(height/factor<=5000)){
-        QTransform oldMatrix = m_view->transform();
-        qreal newScale=oldMatrix.m11()*factor;
-        m_view->resetTransform();
-        m_view->translate(oldMatrix.dx(), oldMatrix.dy());
-        m_view->scale(newScale, newScale);
+    QTransform oldMatrix = m_view->transform();
+    qreal newScale=oldMatrix.m11()*factor;
+    m_view->resetTransform();
+    m_view->translate(oldMatrix.dx(), oldMatrix.dy());
+    m_view->scale(newScale, newScale);
 
-        setGrid();
-    }
+    setGrid();
 }
 /*!
  * \brief zoom with keeping the pointer at the same position
+ * The view animates the zoom, grid is adapted when it settles.
  * \param factor
  * \param pointer
  */
 void MainWindow::zoomPointer(const qreal factor, QPointF pointer)
 {
-    QRectF r=m_view->mapToScene(m_view->viewport()->rect()).boundingRect();
-    if(r.contains(pointer)){
-        r=r.translated(-pointer);
-        r.setRect(r.x()/factor,r.y()/factor,r.width()/factor,r.height()/factor);
-        r.translate(pointer);
-
-        doZoomRect(r.topLeft(),r.bottomRight());
-    }
+    m_view->zoomAt(factor,pointer);
 }
 
 void MainWindow::zoomRect()
@@ -1733,9 +1746,11 @@ void MainWindow::doZoomRect(QPointF p1,QPointF p2)
 
 void MainWindow::zoomFit()
 {
-    m_scene->setCursorVisible(false);
-    m_view->fitInView(m_scene->itemsBoundingRect(),Qt::KeepAspectRatio);
-    m_scene->setCursorVisible(true);
+    const QRectF bounds=m_scene->contentBounds();
+    if(bounds.isNull()){
+        return;
+    }
+    m_view->fitInView(bounds,Qt::KeepAspectRatio);
     setGrid();
 }
 /*!
@@ -1767,11 +1782,124 @@ void MainWindow::changeGridCoarser()
 void MainWindow::toggleGrid(bool grid)
 {
     m_scene->setGridVisible(grid);
+    // tiles of the other background would only take up memory
+    m_view->invalidateTiles();
     QPointF topLeft     = m_view->mapToScene( 0, 0 );
     QPointF bottomRight = m_view->mapToScene( m_view->viewport()->width() - 1, m_view->viewport()->height() - 1 );
     m_scene->invalidate(topLeft.x(),topLeft.y(),bottomRight.x()-topLeft.x(),bottomRight.y()-topLeft.y());
     configuration.showGrid=grid;
 }
+/*!
+ * \brief show/hide performance overlay
+ * \param visible
+ */
+void MainWindow::toggleHud(bool visible)
+{
+    m_view->setHudVisible(visible);
+}
+/*!
+ * \brief switch saving of element definitions with the document
+ * \param embed
+ */
+void MainWindow::toggleEmbedElements(bool embed)
+{
+    m_scene->setEmbedElements(embed);
+    configuration.embedElements=embed;
+}
+/*!
+ * \brief edit additional library directories, one per line
+ * The library is read again; afterwards only changed files are reloaded.
+ */
+void MainWindow::editLibraryPaths()
+{
+    bool ok;
+    const QString text=QInputDialog::getMultiLineText(this, tr("Library Directories"),
+                                                      tr("Additional directories, one per line:"),
+                                                      configuration.libraryPaths.join('\n'), &ok);
+    if(!ok){
+        return;
+    }
+    QStringList paths;
+    for(const QString &line:text.split('\n')){
+        const QString path=line.trimmed();
+        if(!path.isEmpty()){
+            paths<<path;
+        }
+    }
+    configuration.libraryPaths=paths;
+    m_library->setDirectories(libraryDirectories());
+}
+/*!
+ * \brief switch between direct and tile cached painting
+ * \param enable
+ */
+void MainWindow::toggleTiledRendering(bool enable)
+{
+    configuration.tiledRendering=enable;
+    updateRenderMode();
+}
+/*!
+ * \brief switch rasterizing of tiles on worker threads
+ * \param enable
+ */
+void MainWindow::toggleParallelRendering(bool enable)
+{
+    configuration.parallelRendering=enable;
+    updateRenderMode();
+}
+/*!
+ * \brief apply render mode from configuration
+ */
+void MainWindow::updateRenderMode()
+{
+    if(configuration.parallelRendering){
+        m_view->setRenderMode(DiagramView::ParallelRendering);
+    }else if(configuration.tiledRendering){
+        m_view->setRenderMode(DiagramView::TiledRendering);
+    }else{
+        m_view->setRenderMode(DiagramView::DirectRendering);
+    }
+}
+/*!
+ * \brief start/stop recording of an input session
+ * \param record
+ */
+void MainWindow::toggleRecording(bool record)
+{
+    if(!record){
+        m_recorder->stop();
+        return;
+    }
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Record Session"),
+                                                    m_lastPath,
+                                                    tr("QDia Sessions (*.qdiasession)"));
+    if(fileName.isEmpty() || !m_recorder->start(fileName,m_fileName)){
+        QSignalBlocker blocker(recordSessionAction);
+        recordSessionAction->setChecked(false);
+    }
+}
+/*!
+ * \brief replay session given by --replay, print latencies and quit
+ */
+void MainWindow::replaySession()
+{
+    SessionReplay replay(m_view);
+    QList<QAction*> actions=findChildren<QAction*>();
+    actions.removeOne(recordSessionAction);
+    replay.watch(actions,listOfShortcuts);
+    if(!replay.load(m_replayFileName)){
+        QTextStream(stderr)<<"cannot read session "<<m_replayFileName<<"\n";
+        QCoreApplication::exit(1);
+        return;
+    }
+    if(m_fileName.isEmpty() && !replay.document().isEmpty()){
+        openFile(replay.document());
+    }
+    replay.run();
+    QTextStream(stdout)<<replay.report();
+    QCoreApplication::exit(0);
+}
 /*!
  * \brief update grid painting after zoom etc
  */
@@ -1830,6 +1958,10 @@ void MainWindow::fileSaveAs(bool selectedItemsOnly,QString pathSuggestion)
                 << file.errorString();
             }else{
                 setWindowFilePath(m_fileName);
+                if(!selectedItemsOnly){
+                    m_journal->discard();
+                    m_journal->start(m_fileName);
+                }
             }
         }
         QFileInfo fi(fileName);
@@ -1851,6 +1983,9 @@ void MainWindow::fileSave()
             m_recentFiles.prepend(m_fileName);
             populateRecentFiles();
             m_lastSavedSnapshot=m_scene->getSnaphotPosition();
+            file.close();
+            m_journal->discard();
+            m_journal->start(m_fileName);
         }
     }else{
         fileSaveAs();
@@ -1859,15 +1994,34 @@ void MainWindow::fileSave()
 
 void MainWindow::fileOpen()
 {
-    QFileDialog::Options options;
-    QString selectedFilter;
     QString path=m_lastPath.isEmpty() ? "" : m_lastPath+QDir::separator();
-    QString fileName = QFileDialog::getOpenFileName(this,
-            tr("Load Diagram"),
-            path+"dia.json",
-            tr("QDiagram (*.qdia);;QDiagram old(*.json)"),
-            &selectedFilter,
-            options);
+    QFileDialog dialog(this, tr("Load Diagram"), path+"dia.json",
+                       tr("QDiagram (*.qdia);;QDiagram old(*.json)"));
+    dialog.setFileMode(QFileDialog::ExistingFile);
+    // native dialogs can not show the preview of the document header
+    dialog.setOption(QFileDialog::DontUseNativeDialog);
+    auto *preview=new QLabel;
+    preview->setFixedSize(256,256);
+    preview->setAlignment(Qt::AlignCenter);
+    preview->setWordWrap(true);
+    auto *layout=qobject_cast<QGridLayout*>(dialog.layout());
+    if(layout){
+        layout->addWidget(preview,0,layout->columnCount(),layout->rowCount(),1);
+    }
+    connect(&dialog, &QFileDialog::currentChanged, preview, [this, preview](const QString &fn){
+        const QJsonObject header=DiagramScene::readHeader(fn);
+        const QImage image=DiagramScene::headerPreview(header);
+        if(!image.isNull()){
+            preview->setPixmap(QPixmap::fromImage(image));
+        }else{
+            preview->setText(header.isEmpty() ? QString() : documentSummary(header));
+        }
+        preview->setToolTip(header.isEmpty() ? QString() : documentSummary(header));
+    });
+    QString fileName;
+    if(dialog.exec()==QDialog::Accepted && !dialog.selectedFiles().isEmpty()){
+        fileName=dialog.selectedFiles().first();
+    }
     if (!fileName.isEmpty()){
         openFile(fileName);
         m_recentFiles.removeOne(fileName);
@@ -1890,11 +2044,68 @@ bool MainWindow::openFile(QString fileName)
     }
     abort(); // force defined state
     m_scene->clear();
+    m_scene->resetLayers();
+    m_scene->resetSymbols();
     m_scene->load_json(&file);
+    m_scene->fitSceneRect();
     m_fileName=fileName;
     setWindowFilePath(m_fileName);
+    startJournal(m_fileName);
     return true;
 }
+/*!
+ * \brief offer recovery of unsaved changes, then journal further changes
+ * \param fileName saved document, empty for a new one
+ */
+void MainWindow::startJournal(const QString &fileName)
+{
+    // changes of the previous document stay recoverable
+    m_journal->stop();
+    const QString journal=AutosaveJournal::abandonedJournal(fileName);
+    QJsonDocument recovered;
+    if(!journal.isEmpty()){
+        const QString name=fileName.isEmpty() ? tr("a new document") : QFileInfo(fileName).fileName();
+        bool outdated=false;
+        recovered=AutosaveJournal::recover(fileName,journal,&outdated);
+        if(!recovered.isNull()){
+            QString text=tr("There are unsaved changes of %1 from an earlier session.").arg(name);
+            if(outdated){
+                text+="\n"+tr("The document was saved since, recovering replaces it with the state of that session.");
+            }
+            int ret = QMessageBox::question(this, tr("QDia"),
+                                            text+"\n"+tr("Do you want to recover them?"));
+            if(ret!=QMessageBox::Yes){
+                recovered=QJsonDocument();
+                QFile::remove(journal);
+            }
+        }else{
+            // the changes do not apply to the saved document anymore, keep them anyway
+            const QString kept=AutosaveJournal::keepAside(journal);
+            if(!kept.isEmpty()){
+                QMessageBox::warning(this, tr("QDia"),
+                                     tr("There are unsaved changes of %1 from an earlier session, "
+                                        "but they do not apply to the saved document.\n"
+                                        "They were kept in %2.").arg(name,QDir::toNativeSeparators(kept)));
+            }else{
+                QFile::remove(journal);
+            }
+        }
+    }
+    // the recovered state is the first checkpoint of the new journal, the
+    // old one is only removed after that was written
+    if(m_journal->start(fileName,recovered) && !recovered.isNull()
+            && journal!=AutosaveJournal::journalFile(fileName)){
+        QFile::remove(journal);
+    }
+    if(!recovered.isNull()){
+        m_scene->clear();
+        m_scene->resetLayers();
+        m_scene->resetSymbols();
+        m_scene->read_in_json(recovered);
+        m_scene->fitSceneRect();
+        m_scene->takeSnapshot();
+    }
+}
 /*!
  * \brief open recent file
  * triggered from openrecent files menu
@@ -1919,6 +2130,7 @@ QMenu *MainWindow::createArrowMenu(const char *slot, const int def)
     QMenu *arrowMenu = new QMenu;
     for (int i = 0; i < names.count(); ++i) {
         QAction *action = new QAction(names.at(i), this);
+        action->setObjectName(menuActionName(slot,i));
         action->setData(i);
         action->setIcon(createArrowIcon(i));
         connect(action, SIGNAL(triggered()),
@@ -1959,6 +2171,7 @@ QMenu *MainWindow::createLineThicknessMenu(const char *slot, const int def)
     QMenu *thicknessMenu = new QMenu;
     for (int i = 0; i < th.count(); ++i) {
         QAction *action = new QAction(QString("%1").arg(th[i]), this);
+        action->setObjectName(menuActionName(slot,i));
         action->setData(th[i]);
         action->setIcon(createLineThicknesIcon(th[i]));
         connect(action, SIGNAL(triggered()),
@@ -1992,6 +2205,7 @@ QMenu *MainWindow::createLinePatternMenu(const char *slot, const int def)
     QMenu *patternMenu = new QMenu;
     for (int i = 0; i < names.count(); ++i) {
         QAction *action = new QAction(names.at(i), this);
+        action->setObjectName(menuActionName(slot,i));
         action->setData(i);
         action->setIcon(createLinePatternIcon(i));
         connect(action, SIGNAL(triggered()),
@@ -2022,6 +2236,7 @@ QIcon MainWindow::createLinePatternIcon(const int i)
 void MainWindow::transformSelected(const QTransform transform, QList<QGraphicsItem *> items, bool forceOnGrid)
 {
     if(items.isEmpty()) return;
+    m_scene->flushDragPreview();
     m_scene->filterSelectedChildItems(items);
     QRectF bound = m_scene->getTotalBoundary(items);
     QPointF pt=bound.center();
@@ -57,6 +57,10 @@
 #include <QShortcut>
 
 class DiagramScene;
+class DiagramView;
+class SessionRecorder;
+class LibraryBrowser;
+class AutosaveJournal;
 
 QT_BEGIN_NAMESPACE
 class QAction;
@@ -71,6 +75,7 @@ class QFont;
 class QToolButton;
 class QAbstractButton;
 class QGraphicsView;
+class QJsonObject;
 QT_END_NAMESPACE
 
 //#define QDIA_VERSION "0.6" -> see CMakeLists.txt
@@ -110,6 +115,7 @@ private slots:
    void ungroupItems();
    void makeElement();
    void tapItem();
+   void editElementParameters();
    void currentFontChanged(const QFont &font);
    void fontSizeChanged(const QString &size);
    void sceneScaleChanged(const QString &scale);
@@ -142,6 +148,14 @@ private slots:
    void changeGridFiner();
    void changeGridCoarser();
    void toggleGrid(bool grid);
+   void toggleHud(bool visible);
+   void toggleTiledRendering(bool enable);
+   void toggleParallelRendering(bool enable);
+   void toggleEmbedElements(bool embed);
+   void editLibraryPaths();
+   void libraryElementSelected(const QString &fileName, bool userElement);
+   void toggleRecording(bool record);
+   void replaySession();
    void setGrid();
    void fileSave();
    void fileSaveAs(bool selectedItemsOnly=false, QString pathSuggestion="");
@@ -164,6 +178,9 @@ protected:
 
 private:
    void createToolBox();
+   QStringList libraryDirectories() const;
+   QString documentSummary(const QJsonObject &header) const;
+   void startJournal(const QString &fileName);
    void createActions();
    void createMenus();
    void createToolbars();
@@ -185,9 +202,10 @@ private:
 
    void transformSelected(const QTransform transform,QList<QGraphicsItem*> items,bool forceOnGrid=false);
    void transformItems(const QTransform transform,QList<QGraphicsItem*> items,QPointF anchorPoint);
+   void updateRenderMode();
 
    DiagramScene *m_scene;
-   QGraphicsView *m_view;
+   DiagramView *m_view;
 
    QAction *exitAction;
    QAction *addAction;
@@ -219,6 +237,7 @@ private:
    QAction *textAction;
 
    QAction *tapAction;
+   QAction *elementParametersAction;
 
    QAction *zoomInAction;
    QAction *zoomOutAction;
@@ -227,6 +246,12 @@ private:
    QAction *finerGridAction;
    QAction *coarserGridAction;
    QAction *showGridAction;
+   QAction *showHudAction;
+   QAction *tiledRenderingAction;
+   QAction *parallelRenderingAction;
+   QAction *embedElementsAction;
+   QAction *libraryPathsAction;
+   QAction *recordSessionAction;
 
    QAction *printAction;
    QAction *exportAction;
@@ -294,6 +319,11 @@ private:
    QString m_lastPath;
    QString m_lastPathImage;
    int m_lastSavedSnapshot = -1;
+
+   SessionRecorder *m_recorder;
+   AutosaveJournal *m_journal;
+   LibraryBrowser *m_library;
+   QString m_replayFileName;
 };
 
 #endif // MAINWINDOW_H
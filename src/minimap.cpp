@@ -0,0 +1,208 @@
+#include "minimap.h"
+#include "diagramscene.h"
+#include "diagramview.h"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QtMath>
+
+Minimap::Minimap(DiagramView *view, QWidget *parent)
+    : QWidget(parent), m_view(view)
+{
+    m_scale=1.0;
+    m_fullUpdate=true;
+    m_dragging=false;
+    m_updateTimer.setSingleShot(true);
+    m_updateTimer.setInterval(250);
+    connect(&m_updateTimer,&QTimer::timeout,this,&Minimap::updateImage);
+    // QGraphicsScene::changed would also report the cursor and turn off
+    // direct item updates of the views, the scene reports its items itself
+    connect(qobject_cast<DiagramScene*>(m_view->scene()),&DiagramScene::contentChanged,this,&Minimap::sceneChanged);
+    // follow scrolling and zooming of the view
+    for(QScrollBar *bar:{m_view->horizontalScrollBar(),m_view->verticalScrollBar()}){
+        connect(bar,&QScrollBar::valueChanged,this,QOverload<>::of(&QWidget::update));
+        connect(bar,&QScrollBar::rangeChanged,this,QOverload<>::of(&QWidget::update));
+    }
+    setCursor(Qt::PointingHandCursor);
+}
+
+QSize Minimap::sizeHint() const
+{
+    return QSize(240,180);
+}
+/*!
+ * \brief collect dirty areas of the image
+ * \param rect changed scene rect, null if the whole scene changed
+ */
+void Minimap::sceneChanged(const QRectF &rect)
+{
+    if(!isVisible() || rect.isNull()){
+        m_fullUpdate=true;
+    }
+    if(m_fullUpdate){
+        if(isVisible() && !m_updateTimer.isActive()){
+            m_updateTimer.start();
+        }
+        return;
+    }
+    const QRect area=fromScene(rect).toAlignedRect().adjusted(-1,-1,1,1)&QWidget::rect();
+    if(!area.isEmpty()){
+        m_dirty<<area;
+    }
+    // many small changes are rendered as one area
+    if(m_dirty.size()>16){
+        QRect area;
+        for(const QRect &rect:m_dirty){
+            area|=rect;
+        }
+        m_dirty.clear();
+        m_dirty<<area;
+    }
+    if(!m_dirty.isEmpty() && !m_updateTimer.isActive()){
+        m_updateTimer.start();
+    }
+}
+/*!
+ * \brief bring image up to date
+ * Only dirty areas are rendered, unless the document outgrew the image or
+ * the widget was resized.
+ */
+void Minimap::updateImage()
+{
+    auto *scene=qobject_cast<DiagramScene*>(m_view->scene());
+    if(!scene || width()<=0 || height()<=0){
+        return;
+    }
+    const QRectF bounds=scene->contentBounds();
+    if(!bounds.isNull() && !m_coverage.contains(bounds)){
+        m_fullUpdate=true;
+    }
+    if(m_fullUpdate){
+        QRectF cover=bounds.isNull() ? scene->sceneRect() : bounds;
+        const qreal margin=0.05*qMax(cover.width(),cover.height());
+        cover.adjust(-margin,-margin,margin,margin);
+        m_scale=qMin(width()/cover.width(),height()/cover.height());
+        const QSizeF area(width()/m_scale,height()/m_scale);
+        m_coverage=QRectF(cover.center()-QPointF(area.width(),area.height())/2,area);
+
+        const qreal ratio=devicePixelRatioF();
+        m_image=QImage(qCeil(width()*ratio),qCeil(height()*ratio),QImage::Format_ARGB32_Premultiplied);
+        m_image.setDevicePixelRatio(ratio);
+        m_dirty.clear();
+        m_dirty<<rect();
+        m_fullUpdate=false;
+    }
+    for(const QRect &rect:m_dirty){
+        renderArea(rect);
+    }
+    m_dirty.clear();
+    update();
+}
+/*!
+ * \brief render part of the image
+ * The grid is left out, at this scale it would cover everything.
+ * \param rect area in widget coordinates
+ */
+void Minimap::renderArea(const QRect &rect)
+{
+    auto *scene=qobject_cast<DiagramScene*>(m_view->scene());
+    const bool gridVisible=scene->isGridVisible();
+    scene->setGridVisible(false);
+    QPainter painter(&m_image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setClipRect(rect);
+    painter.fillRect(rect,Qt::white);
+    const QRectF source(toScene(rect.topLeft()),QSizeF(rect.size())/m_scale);
+    scene->render(&painter,QRectF(rect),source,Qt::IgnoreAspectRatio);
+    painter.end();
+    scene->setGridVisible(gridVisible);
+}
+/*!
+ * \brief area shown by the view in widget coordinates
+ * \return
+ */
+QRectF Minimap::visibleRect() const
+{
+    return fromScene(m_view->mapToScene(m_view->viewport()->rect()).boundingRect());
+}
+
+QPointF Minimap::toScene(const QPointF &pos) const
+{
+    return m_coverage.topLeft()+pos/m_scale;
+}
+
+QRectF Minimap::fromScene(const QRectF &rect) const
+{
+    return QRectF((rect.topLeft()-m_coverage.topLeft())*m_scale,rect.size()*m_scale);
+}
+
+void Minimap::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    if(m_image.isNull()){
+        painter.fillRect(rect(),Qt::white);
+        return;
+    }
+    painter.drawImage(0,0,m_image);
+    const QRectF visible=visibleRect();
+    QColor color=palette().color(QPalette::Highlight);
+    painter.setPen(QPen(color,1));
+    color.setAlpha(40);
+    painter.setBrush(color);
+    painter.drawRect(visible.adjusted(0.5,0.5,-0.5,-0.5));
+}
+
+void Minimap::resizeEvent(QResizeEvent *event)
+{
+    m_fullUpdate=true;
+    m_updateTimer.start();
+    QWidget::resizeEvent(event);
+}
+
+void Minimap::showEvent(QShowEvent *event)
+{
+    // changes while hidden were not collected
+    m_fullUpdate=true;
+    updateImage();
+    QWidget::showEvent(event);
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event)
+{
+    if(event->button()!=Qt::LeftButton){
+        QWidget::mousePressEvent(event);
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    const QPointF pos=event->position();
+#else
+    const QPointF pos=event->localPos();
+#endif
+    const QRectF visible=visibleRect();
+    m_dragOffset=visible.contains(pos) ? pos-visible.center() : QPointF();
+    m_dragging=true;
+    m_view->centerOn(toScene(pos-m_dragOffset));
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event)
+{
+    if(!m_dragging){
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+    const QPointF pos=event->position();
+#else
+    const QPointF pos=event->localPos();
+#endif
+    m_view->centerOn(toScene(pos-m_dragOffset));
+}
+
+void Minimap::mouseReleaseEvent(QMouseEvent *event)
+{
+    if(event->button()==Qt::LeftButton){
+        m_dragging=false;
+    }
+    QWidget::mouseReleaseEvent(event);
+}
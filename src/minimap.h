@@ -0,0 +1,57 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <QImage>
+#include <QList>
+#include <QTimer>
+#include <QWidget>
+
+class DiagramView;
+
+/*!
+ * \brief overview of the whole document with the visible area of the view
+ * The document is kept as low resolution image. Changes reported by the
+ * scene only re-render their area of the image, at most a few times per
+ * second. The visible rectangle can be dragged, clicking elsewhere centers
+ * the view there.
+ */
+class Minimap : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit Minimap(DiagramView *view, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private slots:
+    void sceneChanged(const QRectF &rect);
+    void updateImage();
+
+private:
+    void renderArea(const QRect &rect);
+    QRectF visibleRect() const;
+    QPointF toScene(const QPointF &pos) const;
+    QRectF fromScene(const QRectF &rect) const;
+
+    DiagramView *m_view;
+    QImage m_image;
+    // scene area covered by the image
+    QRectF m_coverage;
+    qreal m_scale;
+    QList<QRect> m_dirty;
+    bool m_fullUpdate;
+    QTimer m_updateTimer;
+    bool m_dragging;
+    QPointF m_dragOffset;
+};
+
+#endif // MINIMAP_H
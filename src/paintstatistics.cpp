@@ -0,0 +1,105 @@
+#include "paintstatistics.h"
+#include "diagramitem.h"
+#include "diagramdrawitem.h"
+#include "diagramelement.h"
+#include "diagrampathitem.h"
+#include "diagramsplineitem.h"
+#include "diagramsymbol.h"
+#include "diagramtextitem.h"
+
+bool PaintStatistics::s_enabled=false;
+QMap<int,PaintStatistics::TypeStatistic> PaintStatistics::s_current;
+QMap<int,PaintStatistics::TypeStatistic> PaintStatistics::s_last;
+qint64 PaintStatistics::s_lastFrameTime=0;
+qint64 PaintStatistics::s_averageFrameTime=0;
+
+void PaintStatistics::setEnabled(bool enabled)
+{
+    s_enabled=enabled;
+    s_current.clear();
+    s_last.clear();
+    s_lastFrameTime=0;
+    s_averageFrameTime=0;
+}
+/*!
+ * \brief start collecting for a new frame
+ */
+void PaintStatistics::beginFrame()
+{
+    s_current.clear();
+}
+/*!
+ * \brief finish frame, keep its numbers for display
+ * \param nsecs total frame time
+ */
+void PaintStatistics::endFrame(qint64 nsecs)
+{
+    s_last=s_current;
+    s_lastFrameTime=nsecs;
+    // exponential average over roughly the last 16 frames
+    if(s_averageFrameTime==0){
+        s_averageFrameTime=nsecs;
+    }else{
+        s_averageFrameTime+=(nsecs-s_averageFrameTime)/16;
+    }
+}
+
+void PaintStatistics::addPaintTime(int itemType, qint64 nsecs)
+{
+    TypeStatistic &stat=s_current[itemType];
+    ++stat.count;
+    stat.nsecs+=nsecs;
+}
+
+qint64 PaintStatistics::lastFrameTime()
+{
+    return s_lastFrameTime;
+}
+
+qint64 PaintStatistics::averageFrameTime()
+{
+    return s_averageFrameTime;
+}
+/*!
+ * \brief number of items painted in last frame
+ * \return
+ */
+int PaintStatistics::lastItemCount()
+{
+    int result=0;
+    for(const TypeStatistic &stat:s_last){
+        result+=stat.count;
+    }
+    return result;
+}
+
+QMap<int, PaintStatistics::TypeStatistic> PaintStatistics::lastFrame()
+{
+    return s_last;
+}
+/*!
+ * \brief readable name for item type
+ * \param itemType
+ * \return
+ */
+QString PaintStatistics::typeName(int itemType)
+{
+    switch (itemType) {
+    case DiagramItem::Type:
+        return "DiagramItem";
+    case DiagramElement::Type:
+        return "DiagramElement";
+    case DiagramDrawItem::Type:
+        return "DiagramDrawItem";
+    case DiagramPathItem::Type:
+        return "DiagramPathItem";
+    case DiagramSplineItem::Type:
+        return "DiagramSplineItem";
+    case DiagramSymbol::Type:
+        return "DiagramSymbol";
+    case DiagramTextItem::Type:
+        return "DiagramTextItem";
+    default:
+        return QString("type %1").arg(itemType);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PAINTSTATISTICS_H
+#define PAINTSTATISTICS_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QString>
+
+/*!
+ * \brief collects paint timings for the performance HUD
+ * Items report their paint time per item type, the view frames the
+ * measurement. Collection is skipped entirely when disabled.
+ */
+class PaintStatistics
+{
+public:
+    struct TypeStatistic {
+        int count=0;
+        qint64 nsecs=0;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled()
+    {
+        return s_enabled;
+    }
+
+    static void beginFrame();
+    static void endFrame(qint64 nsecs);
+    static void addPaintTime(int itemType, qint64 nsecs);
+
+    static qint64 lastFrameTime();
+    static qint64 averageFrameTime();
+    static int lastItemCount();
+    static QMap<int,TypeStatistic> lastFrame();
+
+    static QString typeName(int itemType);
+
+private:
+    static bool s_enabled;
+    static QMap<int,TypeStatistic> s_current;
+    static QMap<int,TypeStatistic> s_last;
+    static qint64 s_lastFrameTime;
+    static qint64 s_averageFrameTime;
+};
+
+/*!
+ * \brief measure the paint time of one item
+ * Construct at the start of paint(), the destructor reports the time.
+ */
+class PaintTimer
+{
+public:
+    explicit PaintTimer(int itemType)
+        : m_type(itemType), m_active(PaintStatistics::isEnabled())
+    {
+        if(m_active) m_timer.start();
+    }
+    ~PaintTimer()
+    {
+        if(m_active) PaintStatistics::addPaintTime(m_type,m_timer.nsecsElapsed());
+    }
+
+private:
+    int m_type;
+    bool m_active;
+    QElapsedTimer m_timer;
+};
+
+#endif // PAINTSTATISTICS_H
@@ -0,0 +1,89 @@
+#include "performancehud.h"
+#include "paintstatistics.h"
+#include "diagramscene.h"
+
+#include <QGraphicsView>
+#include <QPainter>
+
+PerformanceHud::PerformanceHud(QGraphicsView *view)
+    : QWidget(view->viewport()), m_view(view)
+{
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAutoFillBackground(true);
+    QPalette pal=palette();
+    pal.setColor(QPalette::Window,QColor(40,40,40));
+    pal.setColor(QPalette::WindowText,QColor(230,230,230));
+    setPalette(pal);
+    QFont f("Monospace");
+    f.setStyleHint(QFont::TypeWriter);
+    f.setPointSize(8);
+    setFont(f);
+    move(4,4);
+
+    m_timer.setInterval(250);
+    connect(&m_timer,&QTimer::timeout,this,&PerformanceHud::refresh);
+}
+/*!
+ * \brief collect current numbers and adapt size
+ */
+void PerformanceHud::refresh()
+{
+    m_lines.clear();
+    m_lines<<QString("frame %1 ms (avg %2 ms)")
+             .arg(PaintStatistics::lastFrameTime()/1e6,0,'f',2)
+             .arg(PaintStatistics::averageFrameTime()/1e6,0,'f',2);
+    m_lines<<QString("items painted %1").arg(PaintStatistics::lastItemCount());
+    const QMap<int,PaintStatistics::TypeStatistic> stats=PaintStatistics::lastFrame();
+    for(auto it=stats.constBegin();it!=stats.constEnd();++it){
+        m_lines<<QString("  %1 %2x %3 ms")
+                 .arg(PaintStatistics::typeName(it.key()),-18)
+                 .arg(it.value().count,5)
+                 .arg(it.value().nsecs/1e6,6,'f',2);
+    }
+    auto *scene=qobject_cast<DiagramScene*>(m_view->scene());
+    if(scene){
+        m_lines<<QString("undo history %1").arg(scene->getSnapshotSize());
+        m_lines<<QString("scene items %1").arg(scene->itemCount());
+    }
+    const int hits=DiagramElement::cacheHits();
+    const int lookups=hits+DiagramElement::cacheMisses();
+    m_lines<<QString("element cache %1% (%2/%3)")
+             .arg(lookups>0 ? 100.*hits/lookups : 0.,0,'f',1)
+             .arg(hits).arg(lookups);
+    m_lines<<QString("element variants %1").arg(DiagramElement::variantCount());
+
+    QFontMetrics fm(font());
+    int w=0;
+    for(const QString &line:m_lines){
+        w=qMax(w,fm.horizontalAdvance(line));
+    }
+    resize(w+8,m_lines.size()*fm.lineSpacing()+8);
+    update();
+}
+
+void PerformanceHud::paintEvent(QPaintEvent *)
+{
+    QPainter painter(this);
+    painter.fillRect(rect(),palette().color(QPalette::Window));
+    painter.setPen(palette().color(QPalette::WindowText));
+    QFontMetrics fm(font());
+    int y=4+fm.ascent();
+    for(const QString &line:m_lines){
+        painter.drawText(4,y,line);
+        y+=fm.lineSpacing();
+    }
+}
+
+void PerformanceHud::showEvent(QShowEvent *event)
+{
+    refresh();
+    m_timer.start();
+    QWidget::showEvent(event);
+}
+
+void PerformanceHud::hideEvent(QHideEvent *event)
+{
+    m_timer.stop();
+    QWidget::hideEvent(event);
+}
@@ -0,0 +1,36 @@
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <QWidget>
+#include <QStringList>
+#include <QTimer>
+
+class QGraphicsView;
+
+/*!
+ * \brief overlay showing paint statistics of the view
+ * The HUD is an opaque child of the viewport, so refreshing it does
+ * not repaint (and thus measure) the scene underneath.
+ */
+class PerformanceHud : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit PerformanceHud(QGraphicsView *view);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+
+private slots:
+    void refresh();
+
+private:
+    QGraphicsView *m_view;
+    QTimer m_timer;
+    QStringList m_lines;
+};
+
+#endif // PERFORMANCEHUD_H
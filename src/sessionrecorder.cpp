@@ -0,0 +1,380 @@
+#include "sessionrecorder.h"
+#include "diagramscene.h"
+#include "diagramview.h"
+
+#include <QAction>
+#include <QApplication>
+#include <QGraphicsView>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QShortcut>
+#include <QTextStream>
+#include <QtMath>
+#include <QWheelEvent>
+#include <algorithm>
+
+/*!
+ * \brief name of action in the session file
+ * The object name does not depend on the translation, the text is only
+ * taken for actions without one, e.g. toggle actions of docks.
+ * \param action
+ * \return
+ */
+static QString actionName(const QAction *action)
+{
+    return action->objectName().isEmpty() ? action->text() : action->objectName();
+}
+
+SessionRecorder::SessionRecorder(QGraphicsView *view, QObject *parent)
+    : QObject(parent), m_view(view)
+{
+}
+/*!
+ * \brief record triggering of these actions and shortcuts
+ * May be called again for actions created later, e.g. recent files.
+ * \param actions
+ * \param shortcuts
+ */
+void SessionRecorder::watch(const QList<QAction *> &actions, const QList<QShortcut *> &shortcuts)
+{
+    for(QAction *action:actions){
+        connect(action,&QAction::triggered,this,&SessionRecorder::actionTriggered);
+    }
+    for(QShortcut *shortcut:shortcuts){
+        connect(shortcut,&QShortcut::activated,this,&SessionRecorder::shortcutActivated);
+    }
+}
+/*!
+ * \brief start recording into fileName
+ * \param fileName session file
+ * \param document diagram open at start of the session
+ * \return success
+ */
+bool SessionRecorder::start(const QString &fileName, const QString &document)
+{
+    stop();
+    m_file.setFileName(fileName);
+    if(!m_file.open(QIODevice::WriteOnly|QIODevice::Truncate|QIODevice::Text)){
+        return false;
+    }
+    QJsonObject header;
+    header["qdiaSession"]=1;
+    header["document"]=document;
+    const QTransform t=m_view->transform();
+    header["transform"]=QJsonArray({t.m11(),t.m12(),t.m21(),t.m22(),t.dx(),t.dy()});
+    const QPointF center=m_view->mapToScene(m_view->viewport()->rect().center());
+    header["center"]=QJsonArray({center.x(),center.y()});
+    m_file.write(QJsonDocument(header).toJson(QJsonDocument::Compact)+"\n");
+
+    m_view->viewport()->installEventFilter(this);
+    m_view->installEventFilter(this);
+    m_clock.start();
+    return true;
+}
+
+void SessionRecorder::stop()
+{
+    if(!m_file.isOpen()){
+        return;
+    }
+    m_view->viewport()->removeEventFilter(this);
+    m_view->removeEventFilter(this);
+    m_file.close();
+}
+
+bool SessionRecorder::isRecording() const
+{
+    return m_file.isOpen();
+}
+/*!
+ * \brief catch input events
+ * Mouse and wheel are taken from the viewport, keys from the view itself,
+ * so events propagated from viewport to view are not recorded twice.
+ * \param watched
+ * \param event
+ * \return never filters
+ */
+bool SessionRecorder::eventFilter(QObject *watched, QEvent *event)
+{
+    QJsonObject json;
+    if(watched==m_view->viewport()){
+        switch (event->type()) {
+        case QEvent::MouseButtonPress:
+            json["type"]="press";
+            break;
+        case QEvent::MouseButtonRelease:
+            json["type"]="release";
+            break;
+        case QEvent::MouseButtonDblClick:
+            json["type"]="doubleclick";
+            break;
+        case QEvent::MouseMove:
+            json["type"]="move";
+            break;
+        case QEvent::Wheel:
+        {
+            auto *e=static_cast<QWheelEvent*>(event);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+            const QPointF pos=m_view->mapToScene(e->position().toPoint());
+#else
+            const QPointF pos=m_view->mapToScene(e->pos());
+#endif
+            json["type"]="wheel";
+            json["x"]=pos.x();
+            json["y"]=pos.y();
+            json["delta"]=e->angleDelta().y();
+            json["buttons"]=int(e->buttons());
+            json["modifiers"]=int(e->modifiers());
+            append(json);
+            return false;
+        }
+        default:
+            return false;
+        }
+        auto *e=static_cast<QMouseEvent*>(event);
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+        const QPointF pos=m_view->mapToScene(e->position().toPoint());
+#else
+        const QPointF pos=m_view->mapToScene(e->pos());
+#endif
+        json["x"]=pos.x();
+        json["y"]=pos.y();
+        json["button"]=int(e->button());
+        json["buttons"]=int(e->buttons());
+        json["modifiers"]=int(e->modifiers());
+        append(json);
+    }else if(watched==m_view){
+        if(event->type()!=QEvent::KeyPress && event->type()!=QEvent::KeyRelease){
+            return false;
+        }
+        auto *e=static_cast<QKeyEvent*>(event);
+        json["type"]= event->type()==QEvent::KeyPress ? "keypress" : "keyrelease";
+        json["key"]=e->key();
+        json["text"]=e->text();
+        json["modifiers"]=int(e->modifiers());
+        append(json);
+    }
+    return false;
+}
+
+void SessionRecorder::actionTriggered()
+{
+    auto *action=qobject_cast<QAction*>(sender());
+    if(!action || !isRecording()){
+        return;
+    }
+    QJsonObject json;
+    json["type"]="action";
+    json["name"]=actionName(action);
+    json["checked"]=action->isChecked();
+    append(json);
+}
+
+void SessionRecorder::shortcutActivated()
+{
+    auto *shortcut=qobject_cast<QShortcut*>(sender());
+    if(!shortcut || !isRecording()){
+        return;
+    }
+    QJsonObject json;
+    json["type"]="shortcut";
+    json["name"]=shortcut->key().toString();
+    append(json);
+}
+/*!
+ * \brief add timestamp and write event as one line
+ * \param json
+ */
+void SessionRecorder::append(QJsonObject json)
+{
+    json["t"]=m_clock.elapsed();
+    m_file.write(QJsonDocument(json).toJson(QJsonDocument::Compact)+"\n");
+}
+
+
+SessionReplay::SessionReplay(QGraphicsView *view, QObject *parent)
+    : QObject(parent), m_view(view)
+{
+}
+/*!
+ * \brief actions and shortcuts which may be referenced by the session
+ * \param actions
+ * \param shortcuts
+ */
+void SessionReplay::watch(const QList<QAction *> &actions, const QList<QShortcut *> &shortcuts)
+{
+    m_actions=actions;
+    m_shortcuts=shortcuts;
+}
+/*!
+ * \brief read session file
+ * \param fileName
+ * \return success
+ */
+bool SessionReplay::load(const QString &fileName)
+{
+    QFile file(fileName);
+    if(!file.open(QIODevice::ReadOnly|QIODevice::Text)){
+        return false;
+    }
+    m_header=QJsonObject();
+    m_events.clear();
+    while(!file.atEnd()){
+        const QByteArray line=file.readLine().trimmed();
+        if(line.isEmpty()){
+            continue;
+        }
+        const QJsonObject json=QJsonDocument::fromJson(line).object();
+        if(json.contains("qdiaSession")){
+            m_header=json;
+        }else if(json.contains("type")){
+            m_events.append(json);
+        }
+    }
+    return !m_header.isEmpty();
+}
+/*!
+ * \brief diagram which was open when the session was recorded
+ * \return
+ */
+QString SessionReplay::document() const
+{
+    return m_header.value("document").toString();
+}
+/*!
+ * \brief restore view state and deliver all events
+ */
+void SessionReplay::run()
+{
+    m_latencies.clear();
+    const QJsonArray t=m_header.value("transform").toArray();
+    if(t.size()==6){
+        m_view->setTransform(QTransform(t[0].toDouble(),t[1].toDouble(),t[2].toDouble(),
+                                        t[3].toDouble(),t[4].toDouble(),t[5].toDouble()));
+    }
+    const QJsonArray center=m_header.value("center").toArray();
+    if(center.size()==2){
+        m_view->centerOn(center[0].toDouble(),center[1].toDouble());
+    }
+    QCoreApplication::processEvents();
+
+    QElapsedTimer timer;
+    for(const QJsonObject &json:m_events){
+        timer.start();
+        deliver(json);
+        settle();
+        m_latencies[json.value("type").toString()].append(timer.nsecsElapsed());
+    }
+}
+/*!
+ * \brief wait until the event is fully handled
+ * Work deferred to timers, i.e. coalesced mouse moves and the zoom
+ * animation, is run too, then the resulting repaint is processed.
+ */
+void SessionReplay::settle()
+{
+    QCoreApplication::processEvents();
+    if(auto *scene=qobject_cast<DiagramScene*>(m_view->scene())){
+        scene->flushMouseMove();
+    }
+    auto *view=qobject_cast<DiagramView*>(m_view);
+    while(view && view->isZooming()){
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    QCoreApplication::processEvents();
+}
+/*!
+ * \brief synthesize one recorded event
+ * \param json
+ */
+void SessionReplay::deliver(const QJsonObject &json)
+{
+    const QString type=json.value("type").toString();
+    const Qt::KeyboardModifiers modifiers(json.value("modifiers").toInt());
+    const Qt::MouseButtons buttons(json.value("buttons").toInt());
+    const QPointF pos=m_view->mapFromScene(QPointF(json.value("x").toDouble(),json.value("y").toDouble()));
+    const QPointF globalPos=m_view->viewport()->mapToGlobal(pos.toPoint());
+
+    if(type=="press" || type=="release" || type=="doubleclick" || type=="move"){
+        QEvent::Type eventType=QEvent::MouseMove;
+        if(type=="press"){
+            eventType=QEvent::MouseButtonPress;
+        }else if(type=="release"){
+            eventType=QEvent::MouseButtonRelease;
+        }else if(type=="doubleclick"){
+            eventType=QEvent::MouseButtonDblClick;
+        }
+        QMouseEvent event(eventType,pos,globalPos,Qt::MouseButton(json.value("button").toInt()),buttons,modifiers);
+        QApplication::sendEvent(m_view->viewport(),&event);
+    }else if(type=="wheel"){
+        const QPoint delta(0,json.value("delta").toInt());
+        QWheelEvent event(pos,globalPos,QPoint(),delta,buttons,modifiers,Qt::NoScrollPhase,false);
+        QApplication::sendEvent(m_view->viewport(),&event);
+    }else if(type=="keypress" || type=="keyrelease"){
+        QKeyEvent event(type=="keypress" ? QEvent::KeyPress : QEvent::KeyRelease,
+                        json.value("key").toInt(),modifiers,json.value("text").toString());
+        QApplication::sendEvent(m_view,&event);
+    }else if(type=="action"){
+        const QString name=json.value("name").toString();
+        for(QAction *action:m_actions){
+            if(actionName(action)==name && action->isEnabled()){
+                if(action->isCheckable()){
+                    action->setChecked(!json.value("checked").toBool());
+                }
+                action->trigger();
+                break;
+            }
+        }
+    }else if(type=="shortcut"){
+        const QString name=json.value("name").toString();
+        for(QShortcut *shortcut:m_shortcuts){
+            if(shortcut->key().toString()==name){
+                emit shortcut->activated();
+                break;
+            }
+        }
+    }
+}
+/*!
+ * \brief percentile of sorted values
+ * \param sorted
+ * \param p 0..1
+ * \return
+ */
+static qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    if(sorted.isEmpty()){
+        return 0;
+    }
+    int i=qCeil(p*sorted.size())-1;
+    return sorted.at(qBound(0,i,sorted.size()-1));
+}
+/*!
+ * \brief latency table per event type
+ * \return
+ */
+QString SessionReplay::report() const
+{
+    QString result;
+    QTextStream stream(&result);
+    stream<<QString("%1 %2 %3 %4 %5 %6\n").arg("event",-12).arg("count",6)
+            .arg("p50 ms",9).arg("p90 ms",9).arg("p99 ms",9).arg("max ms",9);
+    QVector<qint64> all;
+    auto line=[&stream](const QString &name,QVector<qint64> values){
+        std::sort(values.begin(),values.end());
+        stream<<QString("%1 %2 %3 %4 %5 %6\n").arg(name,-12).arg(values.size(),6)
+                .arg(percentile(values,0.5)/1e6,9,'f',3)
+                .arg(percentile(values,0.9)/1e6,9,'f',3)
+                .arg(percentile(values,0.99)/1e6,9,'f',3)
+                .arg(percentile(values,1.0)/1e6,9,'f',3);
+    };
+    for(auto it=m_latencies.constBegin();it!=m_latencies.constEnd();++it){
+        line(it.key(),it.value());
+        all+=it.value();
+    }
+    line("all",all);
+    stream.flush();
+    return result;
+}
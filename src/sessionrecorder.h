@@ -0,0 +1,78 @@
+#ifndef SESSIONRECORDER_H
+#define SESSIONRECORDER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QMap>
+#include <QVector>
+
+class QAction;
+class QGraphicsView;
+class QShortcut;
+
+/*!
+ * \brief records input reaching the view and triggered actions
+ * The session file holds one JSON object per line: a header with the
+ * view state followed by the events, positions given in scene coordinates.
+ */
+class SessionRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionRecorder(QGraphicsView *view, QObject *parent = nullptr);
+
+    void watch(const QList<QAction*> &actions, const QList<QShortcut*> &shortcuts);
+    bool start(const QString &fileName, const QString &document);
+    void stop();
+    bool isRecording() const;
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private slots:
+    void actionTriggered();
+    void shortcutActivated();
+
+private:
+    void append(QJsonObject json);
+
+    QGraphicsView *m_view;
+    QFile m_file;
+    QElapsedTimer m_clock;
+};
+
+/*!
+ * \brief feeds a recorded session back into the view
+ * Events are delivered synchronously, one after the other, and the time
+ * until the event and the work it deferred are done is taken as latency
+ * of the event.
+ */
+class SessionReplay : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SessionReplay(QGraphicsView *view, QObject *parent = nullptr);
+
+    void watch(const QList<QAction*> &actions, const QList<QShortcut*> &shortcuts);
+    bool load(const QString &fileName);
+    QString document() const;
+    void run();
+    QString report() const;
+
+private:
+    void deliver(const QJsonObject &json);
+    void settle();
+
+    QGraphicsView *m_view;
+    QList<QAction*> m_actions;
+    QList<QShortcut*> m_shortcuts;
+    QJsonObject m_header;
+    QList<QJsonObject> m_events;
+    QMap<QString,QVector<qint64>> m_latencies;
+};
+
+#endif // SESSIONRECORDER_H
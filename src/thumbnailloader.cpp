@@ -0,0 +1,168 @@
+#include "thumbnailloader.h"
+#include "diagramelement.h"
+#include "diagramscene.h"
+#include "tilerenderer.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QPainter>
+#include <QPicture>
+#include <QStandardPaths>
+#include <QtConcurrent>
+
+/*!
+ * \brief replay recorded element into thumbnail and store it
+ * Runs on a worker thread.
+ * \param data picture data
+ * \param name element name, kept as text in the file
+ * \param cacheFile
+ * \return
+ */
+static QImage rasterize(const QByteArray &data, const QString &name, const QString &cacheFile)
+{
+    const int size=ThumbnailLoader::thumbnailSize;
+    QPicture picture;
+    picture.setData(data.constData(),uint(data.size()));
+    QImage image(size,size,QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+    QPainter painter(&image);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.drawPicture(0,0,picture);
+    painter.end();
+    image.setText("name",name);
+    // drop thumbnails of older states of the file
+    const QFileInfo fi(cacheFile);
+    const QString prefix=fi.fileName().section('-',0,0);
+    QDir dir=fi.absoluteDir();
+    for(const QString &old:dir.entryList({prefix+"-*.png"},QDir::Files)){
+        dir.remove(old);
+    }
+    image.save(cacheFile,"PNG");
+    return image;
+}
+
+ThumbnailLoader::ThumbnailLoader(QObject *parent)
+    : QObject(parent)
+{
+    m_cacheDir=QStandardPaths::writableLocation(QStandardPaths::CacheLocation)+"/thumbnails/";
+    QDir().mkpath(m_cacheDir);
+}
+
+ThumbnailLoader::~ThumbnailLoader()
+{
+    for(QFutureWatcher<QImage> *watcher:findChildren<QFutureWatcher<QImage>*>()){
+        watcher->waitForFinished();
+    }
+}
+/*!
+ * \brief get thumbnail, thumbnailReady() is emitted when done
+ * \param fileName
+ * \param kind
+ */
+void ThumbnailLoader::request(const QString &fileName, Kind kind)
+{
+    const QString file=cacheFile(fileName);
+    auto *watcher=new QFutureWatcher<QImage>(this);
+    connect(watcher,&QFutureWatcher<QImage>::finished,this,[this,watcher,fileName,kind,file](){
+        const QImage image=watcher->result();
+        watcher->deleteLater();
+        if(image.isNull()){
+            render(fileName,kind,file);
+        }else{
+            emit thumbnailReady(fileName,image);
+        }
+    });
+    watcher->setFuture(QtConcurrent::run([file](){
+        QImage image;
+        if(QFileInfo::exists(file)){
+            image.load(file,"PNG");
+        }
+        return image;
+    }));
+}
+/*!
+ * \brief record element and rasterize it on the thread pool
+ * Without threaded font rendering the picture is played on the GUI thread.
+ * \param fileName
+ * \param kind
+ * \param cacheFile
+ */
+void ThumbnailLoader::render(const QString &fileName, Kind kind, const QString &cacheFile)
+{
+    QPicture picture;
+    const QString name=record(fileName,kind,picture);
+    const QByteArray data(picture.data(),int(picture.size()));
+    if(!TileRenderer::isSupported()){
+        emit thumbnailReady(fileName,rasterize(data,name,cacheFile));
+        return;
+    }
+    auto *watcher=new QFutureWatcher<QImage>(this);
+    connect(watcher,&QFutureWatcher<QImage>::finished,this,[this,watcher,fileName](){
+        emit thumbnailReady(fileName,watcher->result());
+        watcher->deleteLater();
+    });
+    watcher->setFuture(QtConcurrent::run(rasterize,data,name,cacheFile));
+}
+/*!
+ * \brief paint element scaled to thumbnail size
+ * User elements saved without preview are loaded into a scene.
+ * \param fileName
+ * \param kind
+ * \param picture
+ * \return name of the element
+ */
+QString ThumbnailLoader::record(const QString &fileName, Kind kind, QPicture &picture) const
+{
+    QPainter painter(&picture);
+    if(kind==Element){
+        DiagramElement item(fileName,nullptr);
+        item.paintIcon(&painter);
+        return item.getName();
+    }
+    // user elements carry a preview in their header, no need to build a scene
+    const QImage preview=DiagramScene::headerPreview(DiagramScene::readHeader(fileName));
+    if(!preview.isNull()){
+        QSizeF size=preview.size();
+        size.scale(thumbnailSize,thumbnailSize,Qt::KeepAspectRatio);
+        const QPointF topLeft((thumbnailSize-size.width())/2,(thumbnailSize-size.height())/2);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+        painter.drawImage(QRectF(topLeft,size),preview);
+        return QFileInfo(fileName).baseName();
+    }
+    DiagramScene scene(nullptr);
+    scene.setGridVisible(false);
+    scene.setCursorVisible(false);
+    QFile file(fileName);
+    if(file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        scene.load_json(&file);
+        scene.render(&painter,QRectF(0,0,thumbnailSize,thumbnailSize),scene.contentBounds());
+    }
+    return QFileInfo(fileName).baseName();
+}
+/*!
+ * \brief thumbnail file for current state of element file
+ * \param fileName
+ * \return
+ */
+QString ThumbnailLoader::cacheFile(const QString &fileName) const
+{
+    const QFileInfo fi(fileName);
+    QCryptographicHash state(QCryptographicHash::Sha1);
+    if(fileName.startsWith(":/")){
+        // resources have no mtime
+        QFile file(fileName);
+        if(file.open(QIODevice::ReadOnly)){
+            state.addData(file.readAll());
+        }
+    }else{
+        state.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+        state.addData(QByteArray::number(fi.size()));
+    }
+    state.addData(QByteArray::number(thumbnailSize));
+    const QByteArray path=QCryptographicHash::hash(fi.absoluteFilePath().toUtf8(),QCryptographicHash::Sha1);
+    return m_cacheDir+QString::fromLatin1(path.toHex().left(16))+"-"
+            +QString::fromLatin1(state.result().toHex().left(16))+".png";
+}
@@ -0,0 +1,41 @@
+#ifndef THUMBNAILLOADER_H
+#define THUMBNAILLOADER_H
+
+#include <QImage>
+#include <QObject>
+#include <QString>
+
+class QPicture;
+
+/*!
+ * \brief icons of library and user elements, made off the GUI thread
+ * Thumbnails are kept on disk, keyed by the file path and its state (mtime
+ * and size, or the content hash for resources). A cache hit is loaded by a
+ * worker. On a miss the element is recorded into a QPicture on the GUI
+ * thread, which a worker rasterizes and stores.
+ */
+class ThumbnailLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Kind { Element, UserElement };
+    static const int thumbnailSize=250;
+
+    explicit ThumbnailLoader(QObject *parent = nullptr);
+    ~ThumbnailLoader() override;
+
+    void request(const QString &fileName, Kind kind);
+
+signals:
+    void thumbnailReady(const QString &fileName, const QImage &image);
+
+private:
+    void render(const QString &fileName, Kind kind, const QString &cacheFile);
+    QString record(const QString &fileName, Kind kind, QPicture &picture) const;
+    QString cacheFile(const QString &fileName) const;
+
+    QString m_cacheDir;
+};
+
+#endif // THUMBNAILLOADER_H
@@ -0,0 +1,95 @@
+#include "tilecache.h"
+
+#include <QList>
+
+/*!
+ * \brief round towards negative infinity
+ */
+static int floorDiv(int a, int b)
+{
+    return a>=0 ? a/b : -((-a+b-1)/b);
+}
+
+TileCache::TileCache(int maxKilobytes)
+{
+    m_tiles.setMaxCost(maxKilobytes);
+}
+
+void TileCache::clear()
+{
+    m_tiles.clear();
+    m_stale.clear();
+}
+/*!
+ * \brief mark tiles of all zoom levels intersecting rect as stale
+ * Only invalidation changes the cache, looking at tiles does not count as
+ * use.
+ * \param rect dirty region in scene coordinates
+ */
+void TileCache::invalidate(const QRectF &rect)
+{
+    // forget marks of tiles dropped since
+    for(auto it=m_stale.begin();it!=m_stale.end();){
+        if(m_tiles.contains(*it)){
+            ++it;
+        }else{
+            it=m_stale.erase(it);
+        }
+    }
+    const QList<TileKey> keys=m_tiles.keys();
+    for(const TileKey &key:keys){
+        // antialiased edges reach a little beyond the bounding rect
+        const qreal margin=2.0/key.scale;
+        if(rect.adjusted(-margin,-margin,margin,margin).intersects(sceneRect(key.scale,key.x,key.y))){
+            m_stale.insert(key);
+        }
+    }
+}
+/*!
+ * \brief cached tile
+ * The pointer is only valid until the next insert().
+ * \param stale set to true if the tile is outdated
+ * \return nullptr if not cached
+ */
+QPixmap *TileCache::tile(qreal scale, int background, int x, int y, bool *stale) const
+{
+    const TileKey key{scale,background,x,y};
+    QPixmap *pixmap=m_tiles.object(key);
+    if(!pixmap){
+        return nullptr;
+    }
+    if(stale){
+        *stale=m_stale.contains(key);
+    }
+    return pixmap;
+}
+
+void TileCache::insert(qreal scale, int background, int x, int y, const QPixmap &pixmap)
+{
+    const int cost=qMax(1,pixmap.width()*pixmap.height()*pixmap.depth()/8/1024);
+    const TileKey key{scale,background,x,y};
+    m_stale.remove(key);
+    m_tiles.insert(key,new QPixmap(pixmap),cost);
+}
+/*!
+ * \brief scene area covered by a tile
+ * \param scale
+ * \param x
+ * \param y
+ * \return
+ */
+QRectF TileCache::sceneRect(qreal scale, int x, int y)
+{
+    const qreal size=tileSize/scale;
+    return QRectF(x*size,y*size,size,size);
+}
+/*!
+ * \brief indices of the tiles touching deviceRect
+ * \param deviceRect rect in pixels of the zoom level, i.e. scene coordinates times scale
+ * \return
+ */
+QRect TileCache::tileRange(const QRect &deviceRect)
+{
+    return QRect(QPoint(floorDiv(deviceRect.left(),tileSize),floorDiv(deviceRect.top(),tileSize)),
+                 QPoint(floorDiv(deviceRect.right(),tileSize),floorDiv(deviceRect.bottom(),tileSize)));
+}
@@ -0,0 +1,67 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <QCache>
+#include <QPixmap>
+#include <QRect>
+#include <QSet>
+
+/*!
+ * \brief identifies one tile of a zoom level
+ * background separates renderings which differ only in the scene
+ * background (grid spacing) at the same scale.
+ */
+struct TileKey
+{
+    qreal scale;
+    int background;
+    int x;
+    int y;
+
+    bool operator==(const TileKey &other) const
+    {
+        return scale==other.scale && background==other.background && x==other.x && y==other.y;
+    }
+};
+
+#if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
+inline size_t qHash(const TileKey &key, size_t seed=0)
+#else
+inline uint qHash(const TileKey &key, uint seed=0)
+#endif
+{
+    return qHash(qRound64(key.scale*65536.0),seed)^qHash(key.background)
+            ^qHash((quint64(quint32(key.x))<<32)|quint32(key.y));
+}
+
+/*!
+ * \brief rendered tiles of a scene for several zoom levels
+ * Tiles are squares of tileSize device independent pixels. Tile (x,y) of
+ * a level with scale s covers the scene rect starting at (x,y)*tileSize/s.
+ * The least recently used tiles are dropped when the size limit is reached.
+ * Invalidated tiles are kept as stale until replaced, so they can be shown
+ * while the new rendering is in progress.
+ */
+class TileCache
+{
+public:
+    enum { tileSize=256 };
+
+    explicit TileCache(int maxKilobytes=65536);
+
+    void clear();
+    void invalidate(const QRectF &rect);
+    QPixmap *tile(qreal scale, int background, int x, int y, bool *stale=nullptr) const;
+    void insert(qreal scale, int background, int x, int y, const QPixmap &pixmap);
+    int count() const { return m_tiles.count(); }
+
+    static QRectF sceneRect(qreal scale, int x, int y);
+    static QRect tileRange(const QRect &deviceRect);
+
+private:
+    mutable QCache<TileKey,QPixmap> m_tiles;
+    // kept apart, marking must not change the order of use
+    QSet<TileKey> m_stale;
+};
+
+#endif // TILECACHE_H
@@ -0,0 +1,132 @@
+#include "tilerenderer.h"
+#include "tilecache.h"
+
+#include <QFontDatabase>
+#include <QGraphicsScene>
+#include <QPicture>
+#include <QtConcurrent>
+#include <QtMath>
+
+/*!
+ * \brief replay display list into one tile
+ * Runs on a worker thread.
+ * \param job
+ * \return
+ */
+static TileRenderer::Result rasterize(const TileRenderer::Job &job)
+{
+    const int size=TileCache::tileSize;
+    // each thread needs its own picture, playing reads from a shared buffer
+    QPicture picture;
+    picture.setData(job.picture.constData(),uint(job.picture.size()));
+    QImage image(qCeil(size*job.ratio),qCeil(size*job.ratio),QImage::Format_ARGB32_Premultiplied);
+    image.setDevicePixelRatio(job.ratio);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.setRenderHints(job.hints);
+    painter.translate(-job.offset);
+    painter.drawPicture(0,0,picture);
+    painter.end();
+    return TileRenderer::Result{job.tile,image};
+}
+
+TileRenderer::TileRenderer(QObject *parent)
+    : QObject(parent)
+{
+    m_scale=1.0;
+    m_background=0;
+    m_busy=false;
+    connect(&m_watcher,&QFutureWatcher<Result>::resultReadyAt,this,&TileRenderer::resultReady);
+    // all results are delivered before finished
+    connect(&m_watcher,&QFutureWatcher<Result>::finished,this,[this](){
+        m_busy=false;
+        m_dirty.clear();
+        emit finished();
+    });
+}
+
+TileRenderer::~TileRenderer()
+{
+    m_watcher.cancel();
+    m_watcher.waitForFinished();
+}
+
+bool TileRenderer::isBusy() const
+{
+    return m_busy;
+}
+/*!
+ * \brief text can only be rendered off the GUI thread if the platform supports it
+ * \return
+ */
+bool TileRenderer::isSupported()
+{
+#if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
+    return QFontDatabase::supportsThreadedFontRendering();
+#else
+    return true;
+#endif
+}
+/*!
+ * \brief record scene area of tiles and start rasterizing
+ * \param scene
+ * \param scale zoom level
+ * \param background key of the scene background, passed back with the results
+ * \param tiles tile indices
+ * \param ratio device pixel ratio of the target
+ * \param hints
+ */
+void TileRenderer::render(QGraphicsScene *scene, qreal scale, int background, const QList<QPoint> &tiles,
+                          qreal ratio, QPainter::RenderHints hints)
+{
+    if(tiles.isEmpty() || isBusy()){
+        return;
+    }
+    const int size=TileCache::tileSize;
+    QRect range;
+    for(const QPoint &tile:tiles){
+        range|=QRect(tile,QSize(1,1));
+    }
+    const QRectF source=TileCache::sceneRect(scale,range.left(),range.top())
+            |TileCache::sceneRect(scale,range.right(),range.bottom());
+
+    QPicture picture;
+    QPainter painter(&picture);
+    painter.setRenderHints(hints);
+    scene->render(&painter,QRectF(0,0,range.width()*size,range.height()*size),source,Qt::IgnoreAspectRatio);
+    painter.end();
+    const QByteArray data(picture.data(),int(picture.size()));
+
+    QList<Job> jobs;
+    for(const QPoint &tile:tiles){
+        jobs<<Job{data,tile,(tile-range.topLeft())*size,ratio,hints};
+    }
+    m_scale=scale;
+    m_background=background;
+    m_dirty.clear();
+    m_busy=true;
+    m_watcher.setFuture(QtConcurrent::mapped(jobs,rasterize));
+}
+/*!
+ * \brief note scene change while a batch is running
+ * \param rect dirty region in scene coordinates
+ */
+void TileRenderer::invalidate(const QRectF &rect)
+{
+    if(isBusy()){
+        m_dirty<<rect;
+    }
+}
+
+void TileRenderer::resultReady(int index)
+{
+    const Result result=m_watcher.resultAt(index);
+    const QRectF area=TileCache::sceneRect(m_scale,result.tile.x(),result.tile.y());
+    const qreal margin=2.0/m_scale;
+    for(const QRectF &rect:m_dirty){
+        if(rect.adjusted(-margin,-margin,margin,margin).intersects(area)){
+            return;
+        }
+    }
+    emit tileRendered(m_scale,m_background,result.tile.x(),result.tile.y(),result.image);
+}
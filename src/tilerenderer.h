@@ -0,0 +1,65 @@
+#ifndef TILERENDERER_H
+#define TILERENDERER_H
+
+#include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QPainter>
+#include <QPoint>
+#include <QRectF>
+
+class QGraphicsScene;
+
+/*!
+ * \brief rasterizes scene tiles on the global thread pool
+ * The scene is painted once on the GUI thread into a QPicture, which is a
+ * read-only display list of the paint commands. The workers only replay
+ * this list into QImages and never touch the items. One batch runs at a
+ * time; tiles touched by scene changes during the run are discarded.
+ */
+class TileRenderer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TileRenderer(QObject *parent = nullptr);
+    ~TileRenderer() override;
+
+    bool isBusy() const;
+    void render(QGraphicsScene *scene, qreal scale, int background, const QList<QPoint> &tiles,
+                qreal ratio, QPainter::RenderHints hints);
+    void invalidate(const QRectF &rect);
+
+    static bool isSupported();
+
+    struct Job
+    {
+        QByteArray picture;
+        QPoint tile;
+        QPoint offset;
+        qreal ratio;
+        QPainter::RenderHints hints;
+    };
+    struct Result
+    {
+        QPoint tile;
+        QImage image;
+    };
+
+signals:
+    void tileRendered(qreal scale, int background, int x, int y, const QImage &image);
+    void finished();
+
+private:
+    void resultReady(int index);
+
+    QFutureWatcher<Result> m_watcher;
+    qreal m_scale;
+    int m_background;
+    bool m_busy;
+    // scene changes since the display list was recorded
+    QList<QRectF> m_dirty;
+};
+
+#endif // TILERENDERER_H